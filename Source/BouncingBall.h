@@ -12,55 +12,214 @@
 
 #include <JuceHeader.h>
 
-class BouncingBall : public Component, public Timer
+/** A ball that bounces around its parent, as a visual check that the message thread is keeping up.
+
+    By default it's a transparent child covering the parent, stepped from the display's vblank
+    callback, and each frame repaints only the rectangles the ball left and entered. The motion is
+    worked out from the time since the last frame, so a late or missed frame moves the ball
+    further rather than slowing it down.
+
+    The original way of drawing it, a separate always-on-top window moved by a 60 Hz timer, is
+    kept as Mode::desktopWindow so the two can be compared with getFrameCost().
+*/
+class BouncingBall : public Component,
+                     private ComponentListener,
+                     private Timer
 {
 public:
+    enum class Mode
+    {
+        overlay,        // painted inside the parent, driven by the vblank
+        desktopWindow   // its own desktop window, moved by a timer
+    };
+
+    /** The message-thread time spent on the ball: stepping it, moving it and painting it. */
+    struct FrameCost
+    {
+        int numFrames = 0;
+        double averageMs = 0.0, maxMs = 0.0;
+    };
+
     BouncingBall (Component& parentComponent)
+        : parent (parentComponent)
     {
-        addToDesktop (ComponentPeer::StyleFlags::windowIgnoresMouseClicks);
-        setVisible (true);
-        setAlwaysOnTop(true);
-        setBounds (5,5,25,25);
-        startTimerHz(60);
+        setInterceptsMouseClicks (false, false);
+        setOpaque (false);
+        parent.addComponentListener (this);
+        setMode (Mode::overlay);
+    }
+
+    ~BouncingBall () override
+    {
+        vblankAttachment.reset ();
+        parent.removeComponentListener (this);
+        parent.removeChildComponent (this);
+    }
+
+    void setMode (Mode newMode)
+    {
+        mode = newMode;
+        vblankAttachment.reset ();
+        stopTimer ();
+        lastFrameSeconds = 0.0;
+
+        if (mode == Mode::desktopWindow)
+        {
+            parent.removeChildComponent (this);
+            addToDesktop (ComponentPeer::StyleFlags::windowIgnoresMouseClicks);
+            setAlwaysOnTop (true);
+            setVisible (true);
+            moveWindow ();
+            startTimerHz (60);
+        }
+        else
+        {
+            if (isOnDesktop ())
+                removeFromDesktop ();
+
+            parent.addAndMakeVisible (this);
+            setAlwaysOnTop (true);
+            setBounds (parent.getLocalBounds ());
+            vblankAttachment = std::make_unique<VBlankAttachment> (this, [this] { advanceFrame (); });
+        }
     }
-    
+
+    Mode getMode () const noexcept      { return mode; }
+
+    /** Returns the figures since the last call, and starts counting again. */
+    FrameCost getFrameCost ()
+    {
+        closeFrame ();
+
+        FrameCost result;
+        result.numFrames = numFramesMeasured;
+        result.averageMs = numFramesMeasured > 0 ? totalFrameSeconds * 1000.0 / numFramesMeasured : 0.0;
+        result.maxMs = maxFrameSeconds * 1000.0;
+
+        numFramesMeasured = 0;
+        totalFrameSeconds = maxFrameSeconds = 0.0;
+        return result;
+    }
+
 private:
-    Point<int> direction{1, 5};
-    
+    static constexpr float diameter = 25.0f;
+    static constexpr double maxStepSeconds = 0.25;     // after a longer stall, just carry on from where it was
+
+    Component& parent;
+    Mode mode = Mode::overlay;
+    std::unique_ptr<VBlankAttachment> vblankAttachment;
+
+    // relative to the area it bounces around in, so it keeps its place when the mode changes
+    Rectangle<float> ball { 5.0f, 5.0f, diameter, diameter };
+    Point<float> velocity { 60.0f, 300.0f };           // pixels per second
+    double lastFrameSeconds = 0.0;
+
+    double currentFrameSeconds = 0.0, totalFrameSeconds = 0.0, maxFrameSeconds = 0.0;
+    int numFramesMeasured = 0;
+    bool frameOpen = false;
+
     void paint (Graphics& g) override
     {
-        const auto bounds = getLocalBounds ();
-        const auto size = jmin (bounds.getWidth (), bounds.getHeight ());
-        
+        const auto startTicks = Time::getHighResolutionTicks ();
+
         g.setColour (Colours::red.withAlpha (0.7f));
-        g.fillEllipse (bounds.toFloat ().withSizeKeepingCentre (size, size));
+        g.fillEllipse (mode == Mode::overlay ? ball : getLocalBounds ().toFloat ());
+
+        currentFrameSeconds += Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks () - startTicks);
     }
-    
+
     void timerCallback () override
     {
-        const auto getLimit = [&]() -> Rectangle<int> {
-            if (auto parent = getParentComponent ())
-                return parent->getLocalBounds ();
-            
-            if (auto display = Desktop::getInstance ().getDisplays ().getPrimaryDisplay ())
-                return display->userArea;
-            
-            return {};
-        };
-        
-        const auto parentBounds = getLimit ();
-        const auto bounds = getBoundsInParent ();
-        
-        if (parentBounds.isEmpty ())
+        advanceFrame ();
+    }
+
+    void componentMovedOrResized (Component&, bool, bool wasResized) override
+    {
+        if (wasResized && mode == Mode::overlay)
+            setBounds (parent.getLocalBounds ());
+    }
+
+    Rectangle<int> getLimits () const
+    {
+        if (mode == Mode::overlay)
+            return getLocalBounds ();
+
+        if (auto display = Desktop::getInstance ().getDisplays ().getPrimaryDisplay ())
+            return display->userArea;
+
+        return {};
+    }
+
+    void advanceFrame ()
+    {
+        closeFrame ();
+
+        const auto startTicks = Time::getHighResolutionTicks ();
+        const auto now = Time::getMillisecondCounterHiRes () * 0.001;
+        const auto elapsed = lastFrameSeconds > 0.0 ? jmin (now - lastFrameSeconds, maxStepSeconds) : 0.0;
+        lastFrameSeconds = now;
+
+        const auto limits = getLimits ();
+
+        if (limits.getWidth () > diameter && limits.getHeight () > diameter)
+        {
+            const auto oldBall = ball;
+
+            auto x = ball.getX () + velocity.x * (float) elapsed;
+            auto y = ball.getY () + velocity.y * (float) elapsed;
+            bounce (x, velocity.x, (float) limits.getWidth () - diameter);
+            bounce (y, velocity.y, (float) limits.getHeight () - diameter);
+            ball.setPosition (x, y);
+
+            if (mode == Mode::overlay)
+            {
+                repaint (oldBall.getSmallestIntegerContainer ());
+                repaint (ball.getSmallestIntegerContainer ());
+            }
+            else
+            {
+                moveWindow ();
+            }
+        }
+
+        currentFrameSeconds += Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks () - startTicks);
+        frameOpen = true;
+    }
+
+    /** Reflects a position off the edges at 0 and limit, turning the velocity round as it does. */
+    static void bounce (float& position, float& speed, float limit) noexcept
+    {
+        if (position < 0.0f)
+        {
+            position = -position;
+            speed = std::abs (speed);
+        }
+        else if (position > limit)
+        {
+            position = limit - (position - limit);
+            speed = -std::abs (speed);
+        }
+
+        position = jlimit (0.0f, limit, position);
+    }
+
+    void moveWindow ()
+    {
+        setBounds (ball.toNearestInt () + getLimits ().getPosition ());
+    }
+
+    /** Adds the last frame's time (its step plus any painting since) to the figures. */
+    void closeFrame () noexcept
+    {
+        if (! frameOpen)
             return;
-        
-        if (bounds.getRight () >= parentBounds.getRight () || bounds.getX () <= parentBounds.getX ())
-            direction.x *= -1;
-        
-        if (bounds.getY () <= parentBounds.getY () || bounds.getBottom () >= parentBounds.getBottom ())
-            direction.y *= -1;
-        
-        setBounds (bounds.translated (direction.x, direction.y));
-        
+
+        ++numFramesMeasured;
+        totalFrameSeconds += currentFrameSeconds;
+        maxFrameSeconds = jmax (maxFrameSeconds, currentFrameSeconds);
+        currentFrameSeconds = 0.0;
+        frameOpen = false;
     }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BouncingBall)
 };
@@ -0,0 +1,187 @@
+/*
+  ==============================================================================
+
+    CallbackStats.h
+    Created: 16 Oct 2026 10:57:06pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/** Measures every audio callback against its deadline without ever blocking the audio thread.
+
+    The audio thread brackets each callback with beginCallback() and endCallback(). The
+    running totals live on the audio thread and are copied into a triple buffer at the end
+    of every callback, so publishing is a copy and one atomic exchange. Any other thread
+    can call getSnapshot() to read the latest complete set of figures, for display or for
+    logging.
+
+    Durations are kept as a proportion of the buffer period (the time the callback's
+    samples take to play), so the figures mean the same thing at any block size or rate.
+*/
+class CallbackStats
+{
+public:
+    struct Snapshot
+    {
+        /** The histogram covers 0 to 200% of the buffer period; the last bucket also holds anything slower. */
+        static constexpr int numBuckets = 100;
+        static constexpr double bucketWidth = 2.0 / numBuckets;
+
+        uint64 numCallbacks = 0;
+        uint64 numOverruns = 0;                 // callbacks that took longer than their buffer period
+        uint64 numLateCallbacks = 0;            // callbacks that started over two periods after the last one
+        uint64 numHandoffsDuringCallback = 0;   // callbacks during which a new buffer or stream was published
+        uint64 numLoopWraps = 0;
+
+        double bufferPeriodSeconds = 0.0;
+        double lastLoad = 0.0, maxLoad = 0.0;
+        int lastLoopWraps = 0;
+        size_t activeBufferBytes = 0;
+
+        uint32 histogram[numBuckets] = {};
+
+        /** Returns the callback duration, as a proportion of the buffer period, that the given
+            proportion of callbacks came in under, e.g. getLoadPercentile (0.99) for the p99.
+            Accurate to one bucket.
+        */
+        double getLoadPercentile (double proportion) const noexcept
+        {
+            if (numCallbacks == 0)
+                return 0.0;
+
+            const auto target = (uint64) std::ceil (proportion * (double) numCallbacks);
+            uint64 count = 0;
+
+            for (int i = 0; i < numBuckets; ++i)
+            {
+                count += histogram[i];
+
+                if (count >= target)
+                    return jmin ((i + 1) * bucketWidth, maxLoad);
+            }
+
+            return maxLoad;
+        }
+
+        /** A one-line summary, e.g. for the log. */
+        String toString() const
+        {
+            auto percent = [] (double load) { return String (load * 100.0, 1) + "%"; };
+
+            return String ((int64) numCallbacks) + " callbacks of " + String (bufferPeriodSeconds * 1000.0, 2) + " ms"
+                     + ", p50 " + percent (getLoadPercentile (0.5))
+                     + ", p99 " + percent (getLoadPercentile (0.99))
+                     + ", max " + percent (maxLoad)
+                     + ", overruns " + String ((int64) numOverruns)
+                     + ", late " + String ((int64) numLateCallbacks)
+                     + ", handoffs during callback " + String ((int64) numHandoffsDuringCallback)
+                     + ", loop wraps " + String (lastLoopWraps) + "/block"
+                     + ", buffer " + String ((double) activeBufferBytes / (1024.0 * 1024.0), 1) + " MB";
+        }
+    };
+
+    CallbackStats() = default;
+
+    /** Call from prepareToPlay(). */
+    void prepare (double newSampleRate) noexcept
+    {
+        sampleRate.store (newSampleRate);
+        reset();
+    }
+
+    /** Clears the figures at the start of the next callback. Safe to call from any thread. */
+    void reset() noexcept
+    {
+        resetRequested.store (true);
+    }
+
+    //==============================================================================
+    /** Call at the very start of the audio callback. Returns the start time to pass to endCallback(). */
+    int64 beginCallback() noexcept
+    {
+        return Time::getHighResolutionTicks();
+    }
+
+    /** Call at the very end of the audio callback with what it did. Returns true if the
+        callback took longer than its buffer period.
+    */
+    bool endCallback (int64 startTicks, int numSamples, int loopWraps, size_t activeBufferBytes,
+                      bool handoffDuringCallback) noexcept
+    {
+        const auto endTicks = Time::getHighResolutionTicks();
+        const auto rate = sampleRate.load (std::memory_order_relaxed);
+
+        if (resetRequested.exchange (false))
+        {
+            live = {};
+            lastStartTicks = 0;
+        }
+
+        if (rate <= 0.0 || numSamples <= 0)
+            return false;
+
+        const auto period = numSamples / rate;
+        const auto load = Time::highResolutionTicksToSeconds (endTicks - startTicks) / period;
+
+        ++live.numCallbacks;
+        live.bufferPeriodSeconds = period;
+        live.lastLoad = load;
+        live.maxLoad = jmax (live.maxLoad, load);
+        live.lastLoopWraps = loopWraps;
+        live.numLoopWraps += (uint64) loopWraps;
+        live.activeBufferBytes = activeBufferBytes;
+        ++live.histogram[jlimit (0, Snapshot::numBuckets - 1, (int) (load / Snapshot::bucketWidth))];
+
+        if (load > 1.0)
+            ++live.numOverruns;
+
+        if (handoffDuringCallback)
+            ++live.numHandoffsDuringCallback;
+
+        if (lastStartTicks != 0 && Time::highResolutionTicksToSeconds (startTicks - lastStartTicks) > 2.0 * period)
+            ++live.numLateCallbacks;
+
+        lastStartTicks = startTicks;
+
+        // hand the finished copy over and take back whichever one the reader isn't holding
+        slots[(size_t) backIndex] = live;
+        backIndex = middle.exchange (backIndex | freshFlag) & indexMask;
+        return load > 1.0;
+    }
+
+    //==============================================================================
+    /** Returns the figures as of the last callback. Safe to call from any thread except the audio thread. */
+    Snapshot getSnapshot() const
+    {
+        const ScopedLock sl (readerLock);
+
+        if ((middle.load() & freshFlag) != 0)
+            frontIndex = middle.exchange (frontIndex) & indexMask;
+
+        return slots[(size_t) frontIndex];
+    }
+
+private:
+    static constexpr int indexMask = 3, freshFlag = 4;
+
+    std::atomic<double> sampleRate { 0.0 };
+    std::atomic<bool> resetRequested { false };
+
+    // only touched by the audio thread
+    Snapshot live;
+    int64 lastStartTicks = 0;
+    int backIndex = 0;
+
+    // the slot in the middle is whichever one neither side currently owns
+    std::array<Snapshot, 3> slots;
+    mutable std::atomic<int> middle { 1 };
+    mutable int frontIndex = 2;
+    CriticalSection readerLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CallbackStats)
+};
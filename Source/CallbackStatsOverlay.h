@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    CallbackStatsOverlay.h
+    Created: 16 Oct 2026 11:53:38pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "CallbackStats.h"
+
+/** A translucent panel showing the latest CallbackStats, refreshed by its owner. */
+class CallbackStatsOverlay  : public Component
+{
+public:
+    CallbackStatsOverlay()
+    {
+        setInterceptsMouseClicks (false, false);
+    }
+
+    void update (const CallbackStats::Snapshot& newSnapshot)
+    {
+        snapshot = newSnapshot;
+        repaint();
+    }
+
+    void paint (Graphics& g) override
+    {
+        g.fillAll (Colours::black.withAlpha (0.6f));
+
+        auto percent = [] (double load) { return String (load * 100.0, 1) + "%"; };
+        auto area = getLocalBounds().reduced (6, 4);
+        const auto lineHeight = area.getHeight() / 3;
+
+        g.setColour (snapshot.numOverruns > 0 ? Colours::orange : Colours::lightgreen);
+        g.setFont ((float) lineHeight * 0.8f);
+
+        g.drawText ("Callback p50 " + percent (snapshot.getLoadPercentile (0.5))
+                      + "  p99 " + percent (snapshot.getLoadPercentile (0.99))
+                      + "  max " + percent (snapshot.maxLoad),
+                    area.removeFromTop (lineHeight), Justification::centredLeft);
+
+        g.drawText ("Overruns " + String ((int64) snapshot.numOverruns)
+                      + "  late " + String ((int64) snapshot.numLateCallbacks)
+                      + "  handoffs " + String ((int64) snapshot.numHandoffsDuringCallback),
+                    area.removeFromTop (lineHeight), Justification::centredLeft);
+
+        g.drawText ("Wraps/block " + String (snapshot.lastLoopWraps)
+                      + "  buffer " + String ((double) snapshot.activeBufferBytes / (1024.0 * 1024.0), 1) + " MB",
+                    area.removeFromTop (lineHeight), Justification::centredLeft);
+    }
+
+private:
+    CallbackStats::Snapshot snapshot;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CallbackStatsOverlay)
+};
@@ -0,0 +1,250 @@
+/*
+  ==============================================================================
+
+    ChannelRouting.h
+    Created: 16 Oct 2026 11:26:06pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "MixKernels.h"
+
+/** How the channels of a buffer are mixed into the channels of the output: a matrix of
+    gains from each of up to 16 inputs to each of up to 16 outputs.
+
+    The matrix is worked out once, when a buffer is published for playback, and classified
+    then, so that process() on the audio thread goes straight to the cheapest kernel that
+    does the job:
+
+    - identity: output n is input n, one copy per channel.
+    - fanOut: every output is fed by at most one input (mono to stereo, or repeating a
+      stereo pair over 8 outputs, at any gain), so each input is read once and written to
+      all of its outputs in the same pass.
+    - matrix: anything else, e.g. a 5.1 downmix, goes through MixKernels::mixWithRamp(),
+      which works out each vector one output at a time, summing every input that feeds it
+      with a gain other than zero, so an input that feeds several outputs is read once for
+      each of them.
+
+    A default-constructed routing has no channels; use createDefault() or setGain().
+*/
+class ChannelRouting
+{
+public:
+    static constexpr int maxInputs = 16;
+    static constexpr int maxOutputs = MixKernels::maxDestinations;
+
+    enum class Kind
+    {
+        identity,
+        fanOut,
+        matrix
+    };
+
+    ChannelRouting() = default;
+
+    /** An empty matrix (i.e. silence) of the given shape, for filling in with setGain(). */
+    ChannelRouting (int numInputChannels, int numOutputChannels) noexcept
+        : numInputs (jlimit (0, maxInputs, numInputChannels)),
+          numOutputs (jlimit (0, maxOutputs, numOutputChannels))
+    {
+        classify();
+    }
+
+    /** The routing a buffer gets unless it asks for something else.
+
+        With at least as many outputs as inputs, the inputs are repeated across the outputs,
+        so mono goes to every output and stereo to every pair. With fewer, the standard
+        downmixes are used for quad, 5.1 and 7.1 (in WAV channel order) to stereo, 7.1 to
+        5.1 and anything to mono, with surrounds and centre at -3 dB and the LFE dropped as
+        in ITU-R BS.775. Any other fold adds input n into output n % numOutputs, scaled so
+        that each output keeps roughly the same power.
+    */
+    static ChannelRouting createDefault (int numInputChannels, int numOutputChannels) noexcept
+    {
+        ChannelRouting routing (numInputChannels, numOutputChannels);
+        const auto numIn = routing.numInputs, numOut = routing.numOutputs;
+        constexpr auto minus3dB = MathConstants<float>::sqrt2 * 0.5f;
+
+        // WAV order: L R C LFE, then the backs and (for 7.1) the sides
+        enum { left, right, centre, lfe, surroundLeft, surroundRight, sideLeft, sideRight };
+
+        if (numIn == 0 || numOut == 0)
+        {
+        }
+        else if (numIn <= numOut)
+        {
+            for (int out = 0; out < numOut; ++out)
+                routing.gains[out][out % numIn] = 1.0f;
+        }
+        else if (numOut == 1)
+        {
+            // fold to stereo first, then average the pair
+            const auto stereo = createDefault (numIn, 2);
+
+            for (int in = 0; in < numIn; ++in)
+                routing.gains[0][in] = 0.5f * (stereo.gains[0][in] + stereo.gains[1][in]);
+        }
+        else if (numOut == 2 && (numIn == 4 || numIn == 6 || numIn == 8))
+        {
+            if (numIn == 4)
+            {
+                // quad: FL FR BL BR
+                routing.gains[0][0] = routing.gains[1][1] = 1.0f;
+                routing.gains[0][2] = routing.gains[1][3] = minus3dB;
+            }
+            else
+            {
+                routing.gains[0][left] = routing.gains[1][right] = 1.0f;
+                routing.gains[0][centre] = routing.gains[1][centre] = minus3dB;
+                routing.gains[0][surroundLeft] = routing.gains[1][surroundRight] = minus3dB;
+
+                if (numIn == 8)
+                    routing.gains[0][sideLeft] = routing.gains[1][sideRight] = minus3dB;
+            }
+        }
+        else if (numOut == 6 && numIn == 8)
+        {
+            for (int channel = left; channel <= lfe; ++channel)
+                routing.gains[channel][channel] = 1.0f;
+
+            routing.gains[surroundLeft][surroundLeft] = routing.gains[surroundLeft][sideLeft] = minus3dB;
+            routing.gains[surroundRight][surroundRight] = routing.gains[surroundRight][sideRight] = minus3dB;
+        }
+        else
+        {
+            for (int in = 0; in < numIn; ++in)
+            {
+                const auto out = in % numOut;
+                const auto numFolded = (numIn - out + numOut - 1) / numOut;
+                routing.gains[out][in] = 1.0f / std::sqrt ((float) numFolded);
+            }
+        }
+
+        routing.classify();
+        return routing;
+    }
+
+    //==============================================================================
+    int getNumInputs() const noexcept       { return numInputs; }
+    int getNumOutputs() const noexcept      { return numOutputs; }
+    Kind getKind() const noexcept           { return kind; }
+
+    float getGain (int outputChannel, int inputChannel) const noexcept
+    {
+        jassert (isPositiveAndBelow (outputChannel, numOutputs) && isPositiveAndBelow (inputChannel, numInputs));
+        return gains[outputChannel][inputChannel];
+    }
+
+    /** Changes one gain and reclassifies the matrix. Not for the audio thread to call on a
+        routing that's in use.
+    */
+    void setGain (int outputChannel, int inputChannel, float newGain) noexcept
+    {
+        jassert (isPositiveAndBelow (outputChannel, numOutputs) && isPositiveAndBelow (inputChannel, numInputs));
+        gains[outputChannel][inputChannel] = newGain;
+        classify();
+    }
+
+    bool hasShape (int numInputChannels, int numOutputChannels) const noexcept
+    {
+        return numInputs == jmin (numInputChannels, maxInputs) && numOutputs == jmin (numOutputChannels, maxOutputs);
+    }
+
+    //==============================================================================
+    /** Mixes getNumInputs() input channels into getNumOutputs() output channels through the
+        matrix, with a linear gain ramp on top (startGain + i * gainStep for sample i).
+
+        With accumulate set the result is added to the outputs; otherwise it replaces them,
+        and outputs that nothing is routed to are cleared. Doesn't lock or allocate.
+    */
+    void process (const float* const* inputs, float* const* outputs, int numSamples,
+                  float startGain, float gainStep, bool accumulate) const noexcept
+    {
+        if (kind == Kind::matrix)
+        {
+            MixKernels::mixWithRamp (outputs, numOutputs, inputs, numInputs, &gains[0][0], maxInputs,
+                                     numSamples, startGain, gainStep, accumulate);
+            return;
+        }
+
+        for (int in = 0; in < numInputs; ++in)
+        {
+            const auto numDests = numDestinations[in];
+
+            if (numDests == 0)
+                continue;
+
+            float* dests[maxOutputs];
+
+            for (int d = 0; d < numDests; ++d)
+                dests[d] = outputs[destinations[in][d]];
+
+            const auto gain = fanOutGains[in];
+
+            if (accumulate)
+                MixKernels::addWithRamp (dests, numDests, inputs[in], numSamples, startGain * gain, gainStep * gain);
+            else
+                MixKernels::copyWithRamp (dests, numDests, inputs[in], numSamples, startGain * gain, gainStep * gain);
+        }
+
+        if (! accumulate)
+            for (int out = 0; out < numOutputs; ++out)
+                if (! isFed[out])
+                    FloatVectorOperations::clear (outputs[out], numSamples);
+    }
+
+private:
+    /** Picks the kernel, and for fan-outs works out which outputs each input feeds. */
+    void classify() noexcept
+    {
+        auto isIdentity = numInputs == numOutputs;
+        auto isFanOut = true;
+
+        for (int in = 0; in < numInputs; ++in)
+        {
+            numDestinations[in] = 0;
+            fanOutGains[in] = 0.0f;
+        }
+
+        for (int out = 0; out < numOutputs; ++out)
+        {
+            int source = -1;
+
+            for (int in = 0; in < numInputs; ++in)
+            {
+                if (gains[out][in] == 0.0f)
+                    continue;
+
+                // a fan-out needs every output fed by one input, at the same gain for all of that input's outputs
+                if (source >= 0 || (numDestinations[in] > 0 && fanOutGains[in] != gains[out][in]))
+                    isFanOut = false;
+
+                source = in;
+            }
+
+            isFed[out] = source >= 0;
+            isIdentity = isIdentity && source == out && gains[out][out] == 1.0f;
+
+            if (isFanOut && source >= 0)
+            {
+                fanOutGains[source] = gains[out][source];
+                destinations[source][numDestinations[source]++] = (uint8) out;
+            }
+        }
+
+        kind = isIdentity ? Kind::identity : (isFanOut ? Kind::fanOut : Kind::matrix);
+    }
+
+    int numInputs = 0, numOutputs = 0;
+    Kind kind = Kind::identity;
+    float gains[maxOutputs][maxInputs] = {};
+
+    // for identity and fanOut: the outputs each input is copied to, and at what gain
+    uint8 destinations[maxInputs][maxOutputs] = {};
+    uint8 numDestinations[maxInputs] = {};
+    float fanOutGains[maxInputs] = {};
+    bool isFed[maxOutputs] = {};
+};
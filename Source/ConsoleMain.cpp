@@ -0,0 +1,62 @@
+/*
+  ==============================================================================
+
+    ConsoleMain.cpp
+    Created: 16 Oct 2026 10:59:43pm
+    Author:  HFM
+
+    The entry point for the headless tools, which drive the same playback code
+    as the app without an audio device or a window.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "PlaybackBenchmark.h"
+#include "OfflineRenderer.h"
+#include "SampleBank.h"
+#include "StressTest.h"
+
+int main (int argc, char* argv[])
+{
+    juce::ConsoleApplication app;
+
+    app.addHelpCommand ("--help|-h", "Usage:", true);
+
+    app.addCommand ({ "--benchmark",
+                      "--benchmark [--fixtures=<folder>] [--output=<file.json>] [--quick]",
+                      "Times the playback path and writes the results as JSON",
+                      "Sweeps block size, channel layout, buffer length, storage format and resampling quality\n"
+                      "over the fixtures in Resources, and reports ns/sample and throughput for each case.",
+                      [] (const juce::ArgumentList& args) { PlaybackBenchmark::run (args); } });
+
+    app.addCommand ({ "--render",
+                      "--render <input> <output.wav|.flac> (--seconds=<n> | --loops=<n>) [--rate=<hz>] [--channels=<n>]\n"
+                      "         [--bits=<16|24>] [--threads=<n>] [--quality=linear|sinc8|sinc16|sinc32]",
+                      "Bounces a looped file to disk faster than real time",
+                      "Renders the loop through the same player as the app, split into time chunks across threads,\n"
+                      "and reports how many times faster than real time it ran.",
+                      [] (const juce::ArgumentList& args) { OfflineRenderer::run (args); } });
+
+    app.addCommand ({ "--build-bank",
+                      "--build-bank <output.bank> <file|folder>... [--rate=<hz>] [--format=float32|int16|float16]\n"
+                      "             [--quality=linear|sinc8|sinc16|sinc32]",
+                      "Decodes audio files into a bank the app can memory-map",
+                      "Decodes every file (folders are searched for anything the format manager can read), converts\n"
+                      "them to one rate if asked, and writes them page-aligned into one file with an index at the front.",
+                      [] (const juce::ArgumentList& args) { SampleBank::runBuildCommand (args); } });
+
+    app.addCommand ({ "--stress",
+                      "--stress [--blocks=<n>] [--seed=<n>] [--output=<file.json>] [--trace=<file.json>]\n"
+                      "         [--baseline=<file.json>] [--tolerance=<percent>] [--quick]",
+                      "Races loading, clearing and device restarts against a simulated audio thread",
+                      "Runs the app's loader, clear button, voice and timer paths on their own threads while the audio\n"
+                      "thread renders flat out, then reports the block time percentiles and each thread's throughput as\n"
+                      "JSON. Fails on a bad sample, a leaked buffer, a real-time violation, or a p99/p99.9 block time or\n"
+                      "throughput more than --tolerance percent (default 25) worse than --baseline. Build with\n"
+                      "-fsanitize=thread or -fsanitize=address to have the sanitizers check the same run. --trace saves the\n"
+                      "end of the run for chrome://tracing or Perfetto.",
+                      [] (const juce::ArgumentList& args) { StressTest::run (args); } });
+
+    return app.findAndRunCommand (argc, argv);
+}
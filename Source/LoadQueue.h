@@ -0,0 +1,239 @@
+/*
+  ==============================================================================
+
+    LoadQueue.h
+    Created: 16 Oct 2026 11:33:19pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "TraceRecorder.h"
+
+/** Runs sample loads on a ThreadPool with two priorities, where each new request to play
+    something supersedes the ones before it.
+
+    Every request gets a generation number. Adding a play-now request cancels every older
+    play-now one: those that haven't started are dropped, and those that are running see
+    isCancelled() turn true, which they check between chunks of their decode. A result
+    is published with publishIfCurrent(), which only runs for the newest play-now request
+    and is serialised with adding new ones. Whichever load finishes last, only the file
+    picked last ever gets played.
+
+    Each job added puts a runner on the pool that takes whatever is most urgent when it
+    gets a thread: the pending play-now request if there is one, otherwise the oldest
+    preload. So a file picked to play now doesn't queue behind a batch of preloads.
+    Preloads aren't superseded, only cancelled by cancelAll().
+*/
+class LoadQueue
+{
+public:
+    enum class Priority
+    {
+        playNow,
+        preload
+    };
+
+    class Request  : public ReferenceCountedObject
+    {
+    public:
+        using Ptr = ReferenceCountedObjectPtr<Request>;
+
+        /** True once a newer play-now request has superseded this one, or the queue is shutting down. */
+        bool isCancelled() const noexcept       { return cancelled.load (std::memory_order_relaxed); }
+
+        Priority getPriority() const noexcept   { return priority; }
+        uint32 getGeneration() const noexcept   { return generation; }
+
+        /** Calls publish if this request hasn't been cancelled, with the queue locked so that
+            no newer request can be added (and publish its own result) in between. Returns
+            whether it did.
+        */
+        template <typename PublishFunction>
+        bool publishIfCurrent (PublishFunction&& publish)
+        {
+            const ScopedLock sl (queue.lock);
+
+            if (isCancelled())
+                return false;
+
+            publish();
+            return true;
+        }
+
+    private:
+        friend class LoadQueue;
+
+        Request (LoadQueue& owner, Priority requestPriority, uint32 requestGeneration, std::function<void (Request&)> jobToRun)
+            : queue (owner), priority (requestPriority), generation (requestGeneration), job (std::move (jobToRun))
+        {
+        }
+
+        LoadQueue& queue;
+        const Priority priority;
+        const uint32 generation;
+        std::function<void (Request&)> job;
+        std::atomic<bool> cancelled { false };
+
+        JUCE_DECLARE_NON_COPYABLE (Request)
+    };
+
+    //==============================================================================
+    explicit LoadQueue (ThreadPool& poolToUse)
+        : pool (poolToUse)
+    {
+    }
+
+    ~LoadQueue()
+    {
+        cancelAll();
+
+        // wait for any runner that is part way through a job
+        RunnerSelector selector (*this);
+        pool.removeAllJobs (false, 10000, &selector);
+    }
+
+    /** Queues a job that's called with its Request on one of the pool's threads. Adding a
+        play-now request cancels every earlier play-now one.
+    */
+    Request::Ptr add (Priority priority, std::function<void (Request&)> job)
+    {
+        Request::Ptr request;
+
+        {
+            const ScopedLock sl (lock);
+            request = new Request (*this, priority, ++lastGeneration, std::move (job));
+
+            if (priority == Priority::playNow)
+            {
+                for (auto& older : running)
+                    if (older->priority == Priority::playNow)
+                        older->cancelled.store (true);
+
+                // an older request that hasn't started never will
+                for (int i = pending.size(); --i >= 0;)
+                {
+                    if (pending.getReference (i)->priority == Priority::playNow)
+                    {
+                        pending.getReference (i)->cancelled.store (true);
+                        pending.remove (i);
+                    }
+                }
+            }
+
+            pending.add (request);
+        }
+
+        pool.addJob (new Runner (*this), true);
+        return request;
+    }
+
+    /** Cancels everything, pending or running. */
+    void cancelAll()
+    {
+        const ScopedLock sl (lock);
+
+        for (auto& request : running)
+            request->cancelled.store (true);
+
+        for (auto& request : pending)
+            request->cancelled.store (true);
+
+        pending.clear();
+    }
+
+    int getNumPending() const
+    {
+        const ScopedLock sl (lock);
+        return pending.size();
+    }
+
+private:
+    class Runner  : public ThreadPoolJob
+    {
+    public:
+        explicit Runner (LoadQueue& queueToServe)
+            : ThreadPoolJob ("Load"), queue (queueToServe)
+        {
+        }
+
+        JobStatus runJob() override
+        {
+            queue.trace->nameCurrentThread ("Load pool");
+
+            if (auto request = queue.takeNext())
+            {
+                {
+                    const TraceRecorder::Span span { *queue.trace, request->priority == Priority::playNow ? "load" : "preload",
+                                                     request->generation };
+                    request->job (*request);
+                }
+
+                queue.finished (*request);
+            }
+
+            return jobHasFinished;
+        }
+
+        LoadQueue& queue;
+    };
+
+    struct RunnerSelector  : public ThreadPool::JobSelector
+    {
+        explicit RunnerSelector (LoadQueue& queueToMatch) : queue (queueToMatch) {}
+
+        bool isJobSuitable (ThreadPoolJob* job) override
+        {
+            auto* runner = dynamic_cast<Runner*> (job);
+            return runner != nullptr && &runner->queue == &queue;
+        }
+
+        LoadQueue& queue;
+    };
+
+    /** The newest play-now request (there's at most one pending), else the oldest preload. */
+    Request::Ptr takeNext()
+    {
+        const ScopedLock sl (lock);
+
+        if (pending.isEmpty())
+            return nullptr;     // its request was superseded, or another runner got there first
+
+        auto index = 0;
+
+        for (int i = 0; i < pending.size(); ++i)
+        {
+            if (pending.getReference (i)->priority == Priority::playNow)
+            {
+                index = i;
+                break;
+            }
+        }
+
+        auto request = pending.getReference (index);
+        pending.remove (index);
+        running.add (request);
+        return request;
+    }
+
+    void finished (Request& request)
+    {
+        const ScopedLock sl (lock);
+
+        for (int i = running.size(); --i >= 0;)
+            if (running.getReference (i).get() == &request)
+                running.remove (i);
+    }
+
+    ThreadPool& pool;
+    SharedResourcePointer<TraceRecorder> trace;
+
+    CriticalSection lock;
+    Array<Request::Ptr> pending;    // in the order they were added
+    Array<Request::Ptr> running;
+    uint32 lastGeneration = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LoadQueue)
+};
@@ -0,0 +1,451 @@
+/*
+  ==============================================================================
+
+    LoopPlayer.h
+    Created: 16 Oct 2026 10:59:43pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ReferenceCountedBuffer.h"
+#include "PolyphaseResampler.h"
+#include "ReleasePool.h"
+#include "ChannelRouting.h"
+
+/** Plays one buffer in a loop: the tutorial's own playback path.
+
+    MainContentComponent calls it from its audio callback, and the console tools drive
+    exactly the same code without an audio device.
+
+    The app publishes what to play as a Playback: a buffer together with its own playback
+    cursor and the output sample time the switch to it should happen at. When a new
+    Playback turns up, the player keeps the old one going up to that sample and then
+    crossfades from one to the other with equal-power gains, without locking or
+    allocating. The outgoing Playback is kept alive through an AudioThreadEpoch::Hazard
+    for as long as the fade lasts.
+
+    The console tools pass a buffer in for each block instead, and it plays from a cursor
+    owned by the player itself.
+
+    A Playback carries the ChannelRouting its buffer is mixed into the output with, worked
+    out when it's published. Buffers passed in directly, or whose routing doesn't match the
+    output they end up in, get ChannelRouting::createDefault() for that shape instead.
+*/
+class LoopPlayer
+{
+public:
+    /** Where a buffer is playing from, in samples of the buffer. */
+    struct Cursor
+    {
+        int position = 0;
+        double resampledPosition = 0.0;
+    };
+
+    //==============================================================================
+    /** A buffer published for playback, with its own cursor. */
+    class Playback  : public ReferenceCountedObject
+    {
+    public:
+        using Ptr = ReferenceCountedObjectPtr<Playback>;
+
+        /** The switch happens at the given output sample time (see getSampleTime()), or at
+            the start of the next block if that has already passed. Pass the routing from
+            the buffer's channels to the output's, e.g. from ChannelRouting::createDefault().
+        */
+        explicit Playback (ReferenceCountedBuffer::Ptr bufferToPlay, int64 switchAtSampleTime = 0,
+                           const ChannelRouting& routingToUse = {})
+            : buffer (std::move (bufferToPlay)), switchTime (switchAtSampleTime), routing (routingToUse)
+        {
+            jassert (buffer != nullptr);
+        }
+
+        const ReferenceCountedBuffer::Ptr& getBuffer() const noexcept   { return buffer; }
+        int64 getSwitchTime() const noexcept                            { return switchTime; }
+        const ChannelRouting& getRouting() const noexcept               { return routing; }
+
+    private:
+        friend class LoopPlayer;
+
+        const ReferenceCountedBuffer::Ptr buffer;
+        const int64 switchTime;
+        const ChannelRouting routing;
+        Cursor cursor;      // only touched by the audio thread
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Playback)
+    };
+
+    //==============================================================================
+    /** A player for the console tools, which can only play buffers passed in directly. */
+    LoopPlayer() = default;
+
+    /** A player that can switch between published Playbacks, using two hazards on the
+        epoch of the ReleasePool they're retired to.
+    */
+    explicit LoopPlayer (AudioThreadEpoch& epochToUse)
+    {
+        for (auto& hazard : hazards)
+            hazard = std::make_unique<AudioThreadEpoch::Hazard> (epochToUse);
+    }
+
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate)
+    {
+        resampler.prepare (samplesPerBlockExpected, maxSpeedRatio);
+        resampledScratch.setSize (PolyphaseResampler::maxChannels, samplesPerBlockExpected);
+        crossfadeScratch.setSize (PolyphaseResampler::maxChannels, samplesPerBlockExpected);
+        crossfadeGains.setSize (2, samplesPerBlockExpected);
+        inputScratch.setSize (ChannelRouting::maxInputs, ReferenceCountedBuffer::maxContiguousRead);
+        deviceSampleRate = sampleRate;
+    }
+
+    /** Picks the interpolation used for buffers that need resampling. Takes effect on the next block. */
+    void setResamplingQuality (ResamplingQuality newQuality) noexcept
+    {
+        quality.store ((int) newQuality);
+    }
+
+    /** Sets how many output samples a switch between Playbacks fades over; 0 switches instantly. */
+    void setCrossfadeLength (int numSamples) noexcept
+    {
+        crossfadeLength.store (jmax (0, numSamples));
+    }
+
+    /** The number of samples rendered so far, i.e. the output time of the next block's first
+        sample. Use it to schedule a Playback. Safe to call from any thread.
+    */
+    int64 getSampleTime() const noexcept
+    {
+        return sampleTime.load (std::memory_order_relaxed);
+    }
+
+    /** Makes the next block start from the beginning of the buffer. Safe to call from any thread. */
+    void rewind() noexcept
+    {
+        rewindRequested.store (true);
+    }
+
+    /** Moves the loop position, in samples of the buffer. Only while nothing is rendering. */
+    void setPosition (double newPosition) noexcept
+    {
+        ownCursor.position = (int) newPosition;
+        ownCursor.resampledPosition = newPosition;
+    }
+
+    /** Renders the next block of bufferToUse into bufferToFill, replacing what's there, and
+        returns the number of times it went round the loop. Doesn't lock or allocate.
+    */
+    int renderNextBlock (const ReferenceCountedBuffer& bufferToUse, const AudioSourceChannelInfo& bufferToFill) noexcept
+    {
+        if (rewindRequested.exchange (false))
+            ownCursor = {};
+
+        const auto loopWraps = renderBuffer (bufferToUse, ownCursor, defaultRouting, *bufferToFill.buffer,
+                                             bufferToFill.startSample, bufferToFill.numSamples);
+        sampleTime.fetch_add (bufferToFill.numSamples, std::memory_order_relaxed);
+        return loopWraps;
+    }
+
+    /** Renders the next block of the latest published Playback (or silence for nullptr),
+        switching to it at its switch time with a crossfade from the one before. A Playback
+        that arrives during a crossfade waits for that fade to finish.
+
+        Returns the number of times the incoming buffer went round its loop. Doesn't lock or
+        allocate. Only for a player constructed with an epoch.
+    */
+    int renderNextBlock (Playback* latest, const AudioSourceChannelInfo& bufferToFill) noexcept
+    {
+        jassert (hazards[0] != nullptr);
+
+        if (rewindRequested.exchange (false) && playing[current] != nullptr)
+            playing[current]->cursor = {};
+
+        const auto blockStartTime = sampleTime.load (std::memory_order_relaxed);
+        auto loopWraps = 0;
+
+        for (auto done = 0; done < bufferToFill.numSamples;)
+        {
+            auto numThisTime = bufferToFill.numSamples - done;
+            const auto startSample = bufferToFill.startSample + done;
+
+            if (! isFading() && latest != playing[current])
+            {
+                // clearing doesn't wait for a particular time
+                const auto switchTime = latest != nullptr ? latest->switchTime : 0;
+                const auto samplesUntilSwitch = (int) jlimit ((int64) 0, (int64) numThisTime, switchTime - (blockStartTime + done));
+
+                if (samplesUntilSwitch == 0)
+                {
+                    beginCrossfade (latest);
+                    continue;
+                }
+
+                numThisTime = samplesUntilSwitch;
+            }
+
+            if (isFading())
+            {
+                numThisTime = jmin (numThisTime, fadeLength - fadePosition, crossfadeScratch.getNumSamples());
+                loopWraps += renderCrossfade (*bufferToFill.buffer, startSample, numThisTime);
+            }
+            else
+            {
+                loopWraps += renderPlayback (playing[current], *bufferToFill.buffer, startSample, numThisTime);
+            }
+
+            done += numThisTime;
+        }
+
+        sampleTime.fetch_add (bufferToFill.numSamples, std::memory_order_relaxed);
+        return loopWraps;
+    }
+
+    /** Lets go of the Playbacks it was holding on to, e.g. while something else is playing,
+        so that they can be released. The next one published will fade in from silence.
+    */
+    void releasePlaybacks() noexcept
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            playing[i] = nullptr;
+
+            if (hazards[i] != nullptr)
+                hazards[i]->set (nullptr);
+        }
+
+        fadeLength = fadePosition = 0;
+    }
+
+private:
+    //==============================================================================
+    bool isFading() const noexcept      { return fadeLength > 0; }
+
+    void beginCrossfade (Playback* incoming) noexcept
+    {
+        // the incoming one goes in the slot the last fade finished with, so the outgoing
+        // one stays protected by its own hazard throughout
+        current = 1 - current;
+        playing[current] = incoming;
+        hazards[current]->set (incoming);
+
+        fadeLength = playing[1 - current] != nullptr || incoming != nullptr ? crossfadeLength.load (std::memory_order_relaxed) : 0;
+        fadePosition = 0;
+
+        if (fadeLength == 0)
+            finishCrossfade();
+    }
+
+    void finishCrossfade() noexcept
+    {
+        const auto outgoing = 1 - current;
+
+        playing[outgoing] = nullptr;
+        hazards[outgoing]->set (nullptr);
+        fadeLength = fadePosition = 0;
+    }
+
+    /** Renders the incoming Playback into the output, the outgoing one into the scratch
+        buffer, and mixes them with gains of sin and cos of the way through the fade.
+    */
+    int renderCrossfade (AudioBuffer<float>& output, int startSample, int numSamples) noexcept
+    {
+        const auto numChannels = jmin (output.getNumChannels(), crossfadeScratch.getNumChannels());
+        AudioBuffer<float> outgoing (crossfadeScratch.getArrayOfWritePointers(), numChannels, numSamples);
+
+        renderPlayback (playing[1 - current], outgoing, 0, numSamples);
+        const auto loopWraps = renderPlayback (playing[current], output, startSample, numSamples);
+
+        auto* fadeIn = crossfadeGains.getWritePointer (0);
+        auto* fadeOut = crossfadeGains.getWritePointer (1);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto angle = MathConstants<float>::halfPi * ((float) (fadePosition + i) + 0.5f) / (float) fadeLength;
+            fadeIn[i] = std::sin (angle);
+            fadeOut[i] = std::cos (angle);
+        }
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* dest = output.getWritePointer (channel, startSample);
+            FloatVectorOperations::multiply (dest, fadeIn, numSamples);
+            FloatVectorOperations::addWithMultiply (dest, outgoing.getReadPointer (channel), fadeOut, numSamples);
+        }
+
+        fadePosition += numSamples;
+
+        if (fadePosition >= fadeLength)
+            finishCrossfade();
+
+        return loopWraps;
+    }
+
+    int renderPlayback (Playback* playback, AudioBuffer<float>& output, int startSample, int numSamples) noexcept
+    {
+        if (playback == nullptr)
+        {
+            output.clear (startSample, numSamples);
+            return 0;
+        }
+
+        return renderBuffer (*playback->buffer, playback->cursor, playback->routing, output, startSample, numSamples);
+    }
+
+    /** The routing the buffer was published with, or the default one if that doesn't fit this output.
+        Also clears any output channels beyond the ones a routing can reach.
+    */
+    const ChannelRouting& getRouting (const ChannelRouting& preferred, const ReferenceCountedBuffer& bufferToUse,
+                                      AudioBuffer<float>& output, int startSample, int numSamples) noexcept
+    {
+        const auto numInputChannels = bufferToUse.getNumChannels();
+        const auto numOutputChannels = output.getNumChannels();
+
+        for (int channel = ChannelRouting::maxOutputs; channel < numOutputChannels; ++channel)
+            output.clear (channel, startSample, numSamples);
+
+        if (preferred.hasShape (numInputChannels, numOutputChannels))
+            return preferred;
+
+        if (! defaultRouting.hasShape (numInputChannels, numOutputChannels))
+            defaultRouting = ChannelRouting::createDefault (numInputChannels, numOutputChannels);
+
+        return defaultRouting;
+    }
+
+    /** Renders a buffer from a cursor, replacing what's in the output, and returns the number of loop wraps. */
+    int renderBuffer (const ReferenceCountedBuffer& bufferToUse, Cursor& cursor, const ChannelRouting& preferredRouting,
+                      AudioBuffer<float>& output, int startSample, int numSamples) noexcept
+    {
+        const auto& routing = getRouting (preferredRouting, bufferToUse, output, startSample, numSamples);
+
+        // buffers that couldn't be converted when they were loaded are resampled here
+        auto bufferSampleRate = bufferToUse.getSampleRate();
+        auto speedRatio = bufferSampleRate > 0.0 ? bufferSampleRate / deviceSampleRate : 1.0;
+
+        if (! approximatelyEqual (speedRatio, 1.0))
+            return renderResampledBuffer (bufferToUse, cursor, routing, output, startSample, numSamples, speedRatio);
+
+        auto numInputChannels = routing.getNumInputs();
+        auto numOutputChannels = routing.getNumOutputs();
+        auto numValidSamples = bufferToUse.getNumValidSamples();
+        auto isFullyLoaded = numValidSamples >= bufferToUse.getNumSamples();
+        auto loopWraps = 0;
+        
+        auto outputSamplesRemaining = numSamples;                                               // [8]
+        auto outputSamplesOffset = startSample;                                                 // [9]
+
+        auto loopRegion = bufferToUse.getLoopRegion();
+        auto& position = cursor.position;
+
+        if (! loopRegion.contains (position))
+            position = loopRegion.getStart();
+
+        // the buffer's loop guard makes each read one contiguous span, even across the loop end
+        while (outputSamplesRemaining > 0)
+        {
+            auto samplesThisTime = jmin (outputSamplesRemaining,                                // [10]
+                                         ReferenceCountedBuffer::maxContiguousRead);            // [11]
+
+            if (! isFullyLoaded && position + samplesThisTime > numValidSamples)
+            {
+                // we've caught up with a buffer that is still being decoded, so wait for it
+                output.clear (outputSamplesOffset, outputSamplesRemaining);
+                break;
+            }
+
+            // compact buffers are converted into the scratch space; float ones are read in place
+            const float* inputs[ChannelRouting::maxInputs];
+            float* outputs[ChannelRouting::maxOutputs];
+
+            for (auto channel = 0; channel < numInputChannels; ++channel)
+            {
+                inputs[channel] = bufferToUse.getLoopReadPointer (channel, position, samplesThisTime);
+
+                if (inputs[channel] == nullptr)
+                {
+                    auto* scratch = inputScratch.getWritePointer (channel);
+                    bufferToUse.readLoop (channel, position, scratch, samplesThisTime);
+                    inputs[channel] = scratch;
+                }
+            }
+
+            for (auto channel = 0; channel < numOutputChannels; ++channel)
+                outputs[channel] = output.getWritePointer (channel, outputSamplesOffset);
+
+            routing.process (inputs, outputs, samplesThisTime, 1.0f, 0.0f, false);
+
+            outputSamplesRemaining -= samplesThisTime;                                          // [13]
+            outputSamplesOffset += samplesThisTime;                                             // [14]
+
+            // a loop shorter than the read goes round more than once
+            loopWraps += (position - loopRegion.getStart() + samplesThisTime) / loopRegion.getLength();
+            position = bufferToUse.advanceLoopPosition (position, samplesThisTime);             // [15] [16]
+        }
+
+        return loopWraps;
+    }
+
+    int renderResampledBuffer (const ReferenceCountedBuffer& bufferToUse, Cursor& cursor, const ChannelRouting& routing,
+                               AudioBuffer<float>& output, int startSample, int numSamples, double speedRatio) noexcept
+    {
+        auto numOutputChannels = routing.getNumOutputs();
+        auto resamplingQuality = (ResamplingQuality) quality.load (std::memory_order_relaxed);
+        auto& resampledPosition = cursor.resampledPosition;
+        auto loopWraps = 0;
+
+        // while the buffer is still being decoded, only go ahead if every tap right of the position
+        // is there; the resampler reads the ones that would wrap to the loop end as silence
+        if (! bufferToUse.isFullyLoaded()
+             && resampledPosition + numSamples * speedRatio + PolyphaseResampler::getNumTaps (resamplingQuality) + 2 >= bufferToUse.getNumValidSamples())
+        {
+            output.clear (startSample, numSamples);
+            return 0;
+        }
+
+        for (auto done = 0; done < numSamples;)
+        {
+            auto samplesThisTime = jmin (numSamples - done, resampledScratch.getNumSamples());
+
+            auto loopRegion = bufferToUse.getLoopRegion();
+            loopWraps += (int) ((resampledPosition - loopRegion.getStart() + samplesThisTime * speedRatio) / loopRegion.getLength());
+
+            resampler.process (bufferToUse, loopRegion, resampledPosition, speedRatio,
+                               resamplingQuality, resampledScratch.getArrayOfWritePointers(), samplesThisTime);
+
+            float* outputs[ChannelRouting::maxOutputs];
+
+            for (auto channel = 0; channel < numOutputChannels; ++channel)
+                outputs[channel] = output.getWritePointer (channel, startSample + done);
+
+            routing.process (resampledScratch.getArrayOfReadPointers(), outputs, samplesThisTime, 1.0f, 0.0f, false);
+
+            done += samplesThisTime;
+        }
+
+        return loopWraps;
+    }
+
+    //==============================================================================
+    static constexpr double maxSpeedRatio = 4.0;
+
+    Cursor ownCursor;
+    std::atomic<bool> rewindRequested { false };
+    std::atomic<int64> sampleTime { 0 };
+
+    // the Playback being faded in (or just playing) is playing[current], the one fading out the other
+    Playback* playing[2] = { nullptr, nullptr };
+    std::unique_ptr<AudioThreadEpoch::Hazard> hazards[2];
+    int current = 0;
+    int fadeLength = 0, fadePosition = 0;
+    std::atomic<int> crossfadeLength { 2048 };
+    AudioBuffer<float> crossfadeScratch, crossfadeGains;
+
+    PolyphaseResampler resampler;
+    AudioBuffer<float> resampledScratch, inputScratch;
+    ChannelRouting defaultRouting;
+    double deviceSampleRate = 0.0;
+    std::atomic<int> quality { (int) ResamplingQuality::sinc16 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LoopPlayer)
+};
@@ -0,0 +1,439 @@
+/*
+  ==============================================================================
+
+    LooperEngine.h
+    Created: 16 Oct 2026 11:56:05pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ReferenceCountedBuffer.h"
+#include "RealtimeHandoff.h"
+#include "StreamingLoopSource.h"
+#include "PolyphaseResampler.h"
+#include "LoopPlayer.h"
+#include "LooperVoiceEngine.h"
+#include "SampleCache.h"
+#include "SampleBank.h"
+#include "ProgressiveLoader.h"
+#include "LoadQueue.h"
+#include "CallbackStats.h"
+#include "TraceRecorder.h"
+#include "RealtimeChecker.h"
+
+/** The app's loading, clearing and playback paths, without any of its GUI, so that
+    MainContentComponent and the stress test drive the same code.
+
+    Files picked with playFile() are loaded on a ThreadPool through a LoadQueue: from the
+    SampleCache, a sample bank, a memory map, a stream from disk or a progressive or
+    whole-file decode. Whatever the newest pick ends up with is handed to the audio thread
+    through a RealtimeHandoff. renderNextBlock() plays it through a LoopPlayer, or plays the
+    stream, mixes the LooperVoiceEngine's voices on top and times the block with CallbackStats.
+
+    The audio device's callbacks go to prepareToPlay(), renderNextBlock() and
+    releaseResources(). Everything else is for the message thread, or any thread that
+    stands in for it.
+*/
+class LooperEngine
+{
+public:
+    struct Options
+    {
+        int maxVoices = 256;
+
+        // files at least this long are streamed through a window of this many samples
+        float streamingThresholdSeconds = 20.0f;
+        int streamingWindowSamples = 1 << 17;
+    };
+
+    /** How to load a file, as the controls were set when it was picked. */
+    struct LoadSettings
+    {
+        bool mapWavFiles = false, convertSampleRate = true;
+        SampleFormat storageFormat = SampleFormat::float32;
+    };
+
+    LooperEngine()
+        : LooperEngine (Options())
+    {
+    }
+
+    explicit LooperEngine (const Options& optionsToUse)
+        : options (optionsToUse)
+    {
+        formatManager.registerBasicFormats();
+        readAheadThread.startThread();
+    }
+
+    ~LooperEngine()
+    {
+        // stop any decode that's still going before the objects it uses are destroyed
+        loadQueue.cancelAll();
+        currentPlayback.publish (nullptr);
+        currentStream.publish (nullptr);
+        voices.stopAllVoices();
+    }
+
+    //==============================================================================
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate, int numOutputChannelsToUse)
+    {
+        numOutputChannels = numOutputChannelsToUse;
+        voices.prepareToPlay (samplesPerBlockExpected, sampleRate, numOutputChannelsToUse);
+
+        loopPlayer.prepareToPlay (samplesPerBlockExpected, sampleRate);
+        loopPlayer.setCrossfadeLength (roundToInt (sampleRate * switchCrossfadeSeconds));
+        deviceSampleRate = sampleRate;
+        callbackStats.prepare (sampleRate);
+    }
+
+    void renderNextBlock (const AudioSourceChannelInfo& bufferToFill) noexcept
+    {
+        // The playback is only borrowed here: currentPlayback keeps the owning reference, and
+        // one that gets replaced is handed to releasePool, which drops it only after this
+        // callback has returned (or, while it's fading out, after loopPlayer lets go of it).
+        // So nothing below can lock, allocate or run a destructor.
+        AudioThreadEpoch::ScopedCallback callback { audioEpoch };
+        RealtimeChecker::ScopedAudioThread realtimeCheck;
+
+        trace->nameCurrentThread ("Audio");
+        const TraceRecorder::Span callbackSpan { *trace, "getNextAudioBlock", bufferToFill.numSamples };
+
+        auto callbackStart = callbackStats.beginCallback();
+        auto numPublishedBefore = getNumPublished();
+        size_t activeBufferBytes = 0;
+        int loopWraps = 0;
+
+        if (auto* stream = currentStream.getForAudioThread())
+        {
+            stream->getNextAudioBlock (bufferToFill);
+            activeBufferBytes = stream->getWindowSizeInBytes();
+            loopPlayer.releasePlaybacks();
+        }
+        else
+        {
+            // switches to the latest playback at its switch time, fading from the last one
+            auto* playback = currentPlayback.getForAudioThread();
+            loopWraps = loopPlayer.renderNextBlock (playback, bufferToFill);
+
+            if (playback != nullptr)
+                activeBufferBytes = playback->getBuffer()->getSizeInBytes();
+        }
+
+        voices.renderNextBlock (*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+
+        if (callbackStats.endCallback (callbackStart, bufferToFill.numSamples, loopWraps, activeBufferBytes,
+                                       getNumPublished() != numPublishedBefore))
+            trace->instant ("overrun");
+    }
+
+    void releaseResources()
+    {
+        currentPlayback.publish (nullptr);
+        currentStream.publish (nullptr);
+        voices.releaseResources();
+    }
+
+    //==============================================================================
+    /** Loads a file on the thread pool and plays it, unless another one has been picked by then.
+        For a sample bank, bankEntry is the index of the entry to play.
+    */
+    void playFile (const File& file, const LoadSettings& settings, int bankEntry = 0)
+    {
+        // each file picked to play supersedes anything still loading to play
+        loadQueue.add (LoadQueue::Priority::playNow, [this, file, settings, bankEntry] (LoadQueue::Request& request)
+        {
+            try
+            {
+                loadAndPlay (request, file, settings, bankEntry);
+            }
+            catch (const std::bad_alloc&)
+            {
+                // like a file that can't be read, this stops whatever an earlier pick left playing
+                reportOutOfMemory (file);
+                request.publishIfCurrent ([this]
+                {
+                    playBuffer (nullptr);
+                    currentStream.publish (nullptr);
+                });
+            }
+        });
+    }
+
+    /** Decodes a file into the cache on the thread pool, so that it plays at once when it's picked. */
+    void preloadFile (const File& file, const LoadSettings& settings)
+    {
+        loadQueue.add (LoadQueue::Priority::preload, [this, file, settings] (LoadQueue::Request& request)
+        {
+            try
+            {
+                preload (request, file, settings);
+            }
+            catch (const std::bad_alloc&)
+            {
+                reportOutOfMemory (file);
+            }
+        });
+    }
+
+    /** Stops everything playing, and cancels every load so that nothing still loading starts playing afterwards. */
+    void clear()
+    {
+        loadQueue.cancelAll();
+
+        playBuffer (nullptr);
+        currentStream.publish (nullptr);
+        voices.stopAllVoices();
+    }
+
+    void setResamplingQuality (ResamplingQuality quality)
+    {
+        loopPlayer.setResamplingQuality (quality);
+        voices.setResamplingQuality (quality);
+    }
+
+    //==============================================================================
+    ReferenceCountedBuffer::Ptr getCurrentBuffer() const
+    {
+        if (auto playback = currentPlayback.get())
+            return playback->getBuffer();
+
+        return nullptr;
+    }
+
+    StreamingLoopSource::Ptr getCurrentStream() const       { return currentStream.get(); }
+    LooperVoiceEngine& getVoices() noexcept                 { return voices; }
+
+    /** The audio callback's timing figures, e.g. for logging. Safe to call from any thread but the audio thread. */
+    CallbackStats::Snapshot getCallbackStats() const        { return callbackStats.getSnapshot(); }
+
+    /** How many buffers and streams have been handed to the audio thread so far. */
+    int64 getNumPublished() const noexcept                  { return (int64) currentPlayback.getNumPublished() + currentStream.getNumPublished(); }
+
+    /** How many loads have failed because the SampleMemoryPool couldn't supply their samples. */
+    int getNumOutOfMemoryLoads() const noexcept             { return numOutOfMemoryLoads.load(); }
+
+    /** The number of loads waiting for a thread. */
+    int getNumPendingLoads() const                          { return loadQueue.getNumPending(); }
+
+    /** The pool the loads run on, for other work that mustn't hold up the message thread. */
+    ThreadPool& getThreadPool() noexcept                    { return threads; }
+
+private:
+    //==============================================================================
+    /** Runs on the thread pool. Whatever it ends up with is only played if no other file has been picked since. */
+    void loadAndPlay (LoadQueue::Request& request, const File& file, const LoadSettings& settings, int bankEntry)
+    {
+        auto play = [this, &request] (ReferenceCountedBuffer::Ptr buffer, StreamingLoopSource::Ptr stream)
+        {
+            request.publishIfCurrent ([&]
+            {
+                playBuffer (buffer);
+                currentStream.publish (stream);
+            });
+        };
+
+        if (file.hasFileExtension ("bank"))
+        {
+            // a bank was decoded when it was built, so opening it only reads its index
+            auto bank = SampleBank::open (file);
+            play (bank != nullptr ? bank->createBuffer (bankEntry) : nullptr, nullptr);
+            return;
+        }
+
+        if (settings.mapWavFiles && file.hasFileExtension ("wav"))
+        {
+            // uncompressed WAVs can be played straight from the page cache, with no decode at all
+            if (auto mappedFile = MappedWavFile::open (file, readAheadThread))
+            {
+                play (new ReferenceCountedBuffer (file.getFileNameWithoutExtension(), std::move (mappedFile)), nullptr);
+                return;
+            }
+        }
+
+        // a file that hasn't changed since it was last decoded (at this rate) plays straight away
+        auto cacheKey = getCacheKey (file, settings);
+
+        if (auto cachedBuffer = sampleCache->get (cacheKey))
+        {
+            play (cachedBuffer, nullptr);
+            return;
+        }
+
+        auto reader = openFile (file);                                                          // [2]
+
+        // a file that can't be read stops whatever an earlier pick left playing, which may be a
+        // progressive load this request cancelled part way through
+        if (reader.get() == nullptr)
+        {
+            play (nullptr, nullptr);
+            return;
+        }
+
+        if (request.isCancelled())
+            return;
+
+        auto duration = (float) reader->lengthInSamples / reader->sampleRate;                   // [3]
+
+        if (duration >= options.streamingThresholdSeconds)
+        {
+            // long files are streamed from disk instead of being decoded up front; there's no
+            // real-time conversion for a stream, so it's converted to the device rate as it's read
+            auto name = file.getFileNameWithoutExtension();
+            auto targetSampleRate = deviceSampleRate.load();
+            auto speedRatio = targetSampleRate > 0.0 ? reader->sampleRate / targetSampleRate : 1.0;
+
+            play (nullptr, new StreamingLoopSource (name, std::move (reader), readAheadThread,
+                                                    options.streamingWindowSamples, speedRatio));
+            return;
+        }
+
+        if (! needsConverting (*reader, settings))
+        {
+            // nothing to convert, so start playing as soon as the first chunk is decoded; the buffer
+            // only goes in the cache once it's complete, so a superseded decode never ends up there
+            ProgressiveLoader::Hooks hooks;
+            hooks.shouldCancel = [requestToCheck = LoadQueue::Request::Ptr (&request)] { return requestToCheck->isCancelled(); };
+            hooks.onFullyLoaded = [this, cacheKey] (ReferenceCountedBuffer::Ptr buffer) { sampleCache->add (cacheKey, buffer); };
+
+            play (ProgressiveLoader::load (file.getFileNameWithoutExtension(), std::move (reader), file, formatManager,
+                                           threads, settings.storageFormat, decodeChunkSize, std::move (hooks)),
+                  nullptr);
+            return;
+        }
+
+        auto newBuffer = decodeWholeFile (request, file, *reader, settings);
+
+        if (newBuffer != nullptr)
+            sampleCache->add (cacheKey, newBuffer);
+
+        play (newBuffer, nullptr);                                                              // [6]
+    }
+
+    /** Runs on the thread pool: decodes a file into the cache, so that it plays at once when it's picked. */
+    void preload (LoadQueue::Request& request, const File& file, const LoadSettings& settings)
+    {
+        // banks and mapped files open without decoding anyway
+        if (file.hasFileExtension ("bank") || (settings.mapWavFiles && file.hasFileExtension ("wav")))
+            return;
+
+        auto cacheKey = getCacheKey (file, settings);
+
+        if (sampleCache->get (cacheKey) != nullptr)
+            return;
+
+        auto reader = openFile (file);
+
+        // long files would be streamed rather than played from the cache
+        if (reader == nullptr || (float) reader->lengthInSamples / reader->sampleRate >= options.streamingThresholdSeconds)
+            return;
+
+        if (auto newBuffer = decodeWholeFile (request, file, *reader, settings))
+            sampleCache->add (cacheKey, newBuffer);
+    }
+
+    /** Decodes a whole file on this thread, a chunk at a time, and converts it to the device rate and the
+        storage format if need be. Returns nullptr if the request is cancelled before it's done.
+    */
+    ReferenceCountedBuffer::Ptr decodeWholeFile (LoadQueue::Request& request, const File& file,
+                                                 AudioFormatReader& reader, const LoadSettings& settings)
+    {
+        auto name = file.getFileNameWithoutExtension();
+        auto convert = needsConverting (reader, settings);
+
+        ProgressiveLoader::Hooks hooks;
+        hooks.shouldCancel = [&request] { return request.isCancelled(); };
+
+        auto newBuffer = ProgressiveLoader::decodeNow (name, reader,                            // [5]
+                                                       convert ? SampleFormat::float32 : settings.storageFormat,
+                                                       decodeChunkSize, std::move (hooks));
+
+        if (newBuffer == nullptr || ! convert)
+            return newBuffer;
+
+        newBuffer = PolyphaseResampler::convertSampleRate (name, *newBuffer, deviceSampleRate.load(), ResamplingQuality::sinc32);
+
+        if (settings.storageFormat != SampleFormat::float32 && ! request.isCancelled())
+            newBuffer = ReferenceCountedBuffer::createCopy (name, *newBuffer, settings.storageFormat);
+
+        return request.isCancelled() ? nullptr : newBuffer;
+    }
+
+    bool needsConverting (const AudioFormatReader& reader, const LoadSettings& settings) const
+    {
+        auto targetSampleRate = deviceSampleRate.load();
+
+        return settings.convertSampleRate && targetSampleRate > 0.0
+                 && ! approximatelyEqual (reader.sampleRate, targetSampleRate);
+    }
+
+    /** Records a load that ran out of sample memory: the pool throws std::bad_alloc when it
+        can't supply a buffer's samples, and that mustn't escape a ThreadPool job.
+    */
+    void reportOutOfMemory (const File& file)
+    {
+        DBG ("Out of sample memory loading " << file.getFileName());
+        trace->instant ("out of sample memory");
+        ++numOutOfMemoryLoads;
+    }
+
+    /** Opens a file for decoding, as a span in the trace. */
+    std::unique_ptr<AudioFormatReader> openFile (const File& file)
+    {
+        const TraceRecorder::Span span { *trace, "open" };
+        return std::unique_ptr<AudioFormatReader> (formatManager.createReaderFor (file));
+    }
+
+    String getCacheKey (const File& file, const LoadSettings& settings) const
+    {
+        return SampleCache::makeKey (file, settings.convertSampleRate ? deviceSampleRate.load() : 0.0, settings.storageFormat);
+    }
+
+    /** Starts playing a buffer from the beginning of its loop, crossfading from whatever was playing. */
+    void playBuffer (ReferenceCountedBuffer::Ptr buffer)
+    {
+        if (buffer == nullptr)
+        {
+            currentPlayback.publish (nullptr);
+            return;
+        }
+
+        // the channel routing is worked out here, once, rather than on every block
+        const auto routing = ChannelRouting::createDefault (buffer->getNumChannels(), numOutputChannels.load());
+        currentPlayback.publish (new LoopPlayer::Playback (buffer, 0, routing));
+    }
+
+    //==============================================================================
+    // switching to another buffer fades between the two over this long
+    static constexpr double switchCrossfadeSeconds = 0.02;
+    static constexpr int decodeChunkSize = 1 << 16;
+
+    const Options options;
+
+    AudioFormatManager formatManager;
+    SharedResourcePointer<SampleMemoryPool> sampleMemory;   // keeps spare sample memory between loads
+    SharedResourcePointer<SampleCache> sampleCache;
+    SharedResourcePointer<TraceRecorder> trace;
+
+    std::atomic<double> deviceSampleRate { 0.0 };
+    std::atomic<int> numOutputChannels { 2 };
+    std::atomic<int> numOutOfMemoryLoads { 0 };
+
+    CallbackStats callbackStats;
+
+    AudioThreadEpoch audioEpoch;
+    TimeSliceThread readAheadThread { "Read-ahead" };
+    ReleasePool releasePool { audioEpoch };
+    RealtimeHandoff<LoopPlayer::Playback> currentPlayback { releasePool };
+    LoopPlayer loopPlayer { audioEpoch };
+    RealtimeHandoff<StreamingLoopSource> currentStream { releasePool };
+    LooperVoiceEngine voices { releasePool, options.maxVoices };
+
+    // declared last so that they're destroyed first: their jobs use the members above
+    ThreadPool threads;
+    LoadQueue loadQueue { threads };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LooperEngine)
+};
@@ -0,0 +1,751 @@
+/*
+  ==============================================================================
+
+    LooperVoiceEngine.h
+    Created: 16 Oct 2026 10:45:38pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ReferenceCountedBuffer.h"
+#include "ReleasePool.h"
+#include "PolyphaseResampler.h"
+#include "RealtimeChecker.h"
+#include "ChannelRouting.h"
+
+/** Plays many looping buffers at once and sums them into the output.
+
+    The voice pool has a fixed size and is allocated in prepareToPlay(). Voices are
+    started and stopped from the message thread by handing a slot over through its
+    atomic state, so the audio thread never locks or allocates. Each voice has its own
+    buffer, position, gain and loop region; gain changes, starts and stops are ramped
+    over one block so they don't click.
+
+    Voices whose buffer was recorded at a different rate than the device runs at, or
+    that have been given a speed other than 1, are read through a PolyphaseResampler.
+
+    Each voice is mixed into the output through a ChannelRouting chosen when it starts,
+    so e.g. a 5.1 loop is folded down into a stereo output rather than losing its centre.
+
+    The voices keep their buffers alive with a reference held on the message-thread
+    side; once the audio thread has let go of a stopped voice, that reference goes to
+    the ReleasePool rather than being dropped in place.
+
+    With worker threads (see setNumWorkerThreads()), a block with enough voices in it is
+    rendered in parallel. The active voices are dealt out between the audio thread and
+    the workers as tasks. Each thread works through its own share from the front and,
+    once that's empty, steals from the back of the others', summing what it renders
+    into a buffer of its own. The audio thread takes part rather than waiting, so a
+    worker that wakes up late costs nothing: its share has simply been stolen. Once
+    every task is done, the audio thread adds the per-thread buffers into the output.
+    Smaller blocks are rendered on the audio thread alone, as is everything when there
+    are no workers.
+*/
+class LooperVoiceEngine
+{
+public:
+    LooperVoiceEngine (ReleasePool& poolToRetireInto, int maxNumVoices)
+        : releasePool (poolToRetireInto),
+          maxVoices (maxNumVoices)
+    {
+    }
+
+    ~LooperVoiceEngine()
+    {
+        stopWorkers();
+    }
+
+    //==============================================================================
+    /** Sets how many threads help the audio thread render large blocks; 0 renders everything
+        on the audio thread. Takes effect at the next prepareToPlay().
+    */
+    void setNumWorkerThreads (int numThreads)
+    {
+        numWorkersRequested.store (jmax (0, numThreads));
+    }
+
+    /** Allocates the voice pool (the first time), the scratch space for this block size and
+        the worker threads. Voices started from now on are routed to numOutputChannels.
+    */
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate, int numOutputChannels = 2)
+    {
+        const ScopedLock sl (messageThreadLock);
+
+        if (voices == nullptr)
+        {
+            voices = std::make_unique<Voice[]> ((size_t) maxVoices);
+            owners.insertMultiple (0, nullptr, maxVoices);
+            activeVoices.allocate ((size_t) maxVoices, true);
+        }
+
+        jassert (sampleRate > 0.0);
+
+        // the audio isn't running here, so the lanes can be rebuilt
+        stopWorkers();
+        lanes.clear();
+
+        for (int i = 0; i <= numWorkersRequested.load(); ++i)
+        {
+            auto* lane = lanes.add (new Lane());
+            lane->conversionScratch.setSize (ChannelRouting::maxInputs, samplesPerBlockExpected);
+            lane->resampledScratch.setSize (PolyphaseResampler::maxChannels, samplesPerBlockExpected);
+            lane->resampler.prepare (samplesPerBlockExpected, maxSpeedRatio);
+            lane->mix.setSize (maxOutputChannels, samplesPerBlockExpected);
+        }
+
+        for (int i = 1; i < lanes.size(); ++i)
+            workers.add (new Worker (*this, i))->startRealtimeThread (Thread::RealtimeOptions{});
+
+        secondsPerSample = 1.0 / sampleRate;
+        outputChannelsExpected = jlimit (1, maxOutputChannels, numOutputChannels);
+    }
+
+    /** Stops the worker threads once the audio has stopped; the next prepareToPlay() starts
+        them again. Blocks rendered in between are rendered on the audio thread alone.
+    */
+    void releaseResources()
+    {
+        const ScopedLock sl (messageThreadLock);
+        stopWorkers();
+    }
+
+    /** Starts a voice looping the given region of a buffer. An empty region uses the
+        buffer's own loop region, which plays without splitting blocks at the loop end.
+        Returns the voice index, or -1 if every voice is busy.
+
+        The voice is mixed through the given routing, or ChannelRouting::createDefault() for
+        the buffer's channels and the output's if that's nullptr.
+    */
+    int startVoice (ReferenceCountedBuffer::Ptr buffer, float gain, Range<int> loopRegion = {}, int startPosition = 0,
+                    const ChannelRouting* routing = nullptr)
+    {
+        const ScopedLock sl (messageThreadLock);
+
+        if (voices == nullptr || buffer == nullptr || buffer->getNumSamples() == 0)
+            return -1;
+
+        reapFinishedVoices();
+
+        for (int i = 0; i < maxVoices; ++i)
+        {
+            auto& voice = voices[(size_t) i];
+
+            if (voice.state.load() != Voice::idle)
+                continue;
+
+            if (loopRegion.isEmpty())
+                loopRegion = buffer->getLoopRegion();
+
+            loopRegion = loopRegion.getIntersectionWith ({ 0, buffer->getNumSamples() });
+
+            if (loopRegion.isEmpty())
+                return -1;
+
+            voice.buffer = buffer.get();
+            voice.loopStart = loopRegion.getStart();
+            voice.loopEnd = loopRegion.getEnd();
+            voice.position = jlimit (voice.loopStart, voice.loopEnd - 1, startPosition);
+            voice.currentGain = 0.0f;
+            voice.targetGain.store (gain);
+            voice.speed.store (1.0f);
+            voice.routing = routing != nullptr ? *routing
+                                               : ChannelRouting::createDefault (buffer->getNumChannels(), outputChannelsExpected);
+            owners.set (i, std::move (buffer));
+
+            // everything above is published to the audio thread by this release-store
+            voice.state.store (Voice::starting, std::memory_order_release);
+            return i;
+        }
+
+        return -1;
+    }
+
+    void setVoiceGain (int voiceIndex, float newGain)
+    {
+        const ScopedLock sl (messageThreadLock);
+
+        if (voices != nullptr && isPositiveAndBelow (voiceIndex, maxVoices))
+            voices[(size_t) voiceIndex].targetGain.store (newGain);
+    }
+
+    /** Changes the playback speed (and so the pitch) of a voice; 1 is the recorded speed. */
+    void setVoiceSpeed (int voiceIndex, float newSpeed)
+    {
+        const ScopedLock sl (messageThreadLock);
+
+        if (voices != nullptr && isPositiveAndBelow (voiceIndex, maxVoices))
+            voices[(size_t) voiceIndex].speed.store (jlimit (0.01f, (float) maxSpeedRatio, newSpeed));
+    }
+
+    /** Picks the interpolation used for voices that need resampling. Takes effect on the next block. */
+    void setResamplingQuality (ResamplingQuality newQuality) noexcept
+    {
+        quality.store ((int) newQuality);
+    }
+
+    /** Fades the voice out over the next block and then frees it. */
+    void stopVoice (int voiceIndex)
+    {
+        const ScopedLock sl (messageThreadLock);
+
+        if (voices != nullptr && isPositiveAndBelow (voiceIndex, maxVoices))
+        {
+            auto expected = (int) Voice::playing;
+
+            if (! voices[(size_t) voiceIndex].state.compare_exchange_strong (expected, Voice::stopping))
+            {
+                expected = Voice::starting;
+                voices[(size_t) voiceIndex].state.compare_exchange_strong (expected, Voice::stopping);
+            }
+        }
+
+        reapFinishedVoices();
+    }
+
+    void stopAllVoices()
+    {
+        for (int i = 0; i < maxVoices; ++i)
+            stopVoice (i);
+    }
+
+    /** Frees the voices that have finished fading out, handing their buffers to the release
+        pool. Call it regularly from the message thread (e.g. a timer), or a stopped voice keeps
+        its slot and its buffer until the next startVoice() or stopVoice().
+    */
+    void releaseFinishedVoices()
+    {
+        const ScopedLock sl (messageThreadLock);
+        reapFinishedVoices();
+    }
+
+    int getNumActiveVoices() const
+    {
+        const ScopedLock sl (messageThreadLock);
+
+        if (voices == nullptr)
+            return 0;
+
+        int count = 0;
+
+        for (int i = 0; i < maxVoices; ++i)
+            if (voices[(size_t) i].state.load() != Voice::idle)
+                ++count;
+
+        return count;
+    }
+
+    /** The time spent in renderNextBlock() as a proportion of the block's duration,
+        smoothed over roughly the last second.
+    */
+    float getCpuLoad() const noexcept       { return cpuLoad.load (std::memory_order_relaxed); }
+
+    //==============================================================================
+    /** Adds every active voice into the given region of the output. Audio thread only. */
+    void renderNextBlock (AudioBuffer<float>& output, int startSample, int numSamples) noexcept
+    {
+        if (voices == nullptr || lanes.isEmpty() || numSamples <= 0)
+            return;
+
+        const auto startTicks = Time::getHighResolutionTicks();
+        int numActive = 0;
+
+        for (int i = 0; i < maxVoices; ++i)
+        {
+            const auto state = voices[(size_t) i].state.load (std::memory_order_relaxed);
+
+            if (state != Voice::idle && state != Voice::finished)
+                activeVoices[numActive++] = i;
+        }
+
+        // splitting the work up only pays off once there's a fair amount of it
+        if (lanes.size() > 1 && numActive > 1
+             && numSamples <= lanes.getFirst()->mix.getNumSamples()
+             && numActive * numSamples >= minVoiceSamplesForParallelBlock)
+        {
+            renderInParallel (output, startSample, numSamples, numActive);
+        }
+        else
+        {
+            for (int i = 0; i < numActive; ++i)
+                renderVoiceTask (activeVoices[i], *lanes.getFirst(), output, startSample, numSamples);
+        }
+
+        const auto elapsed = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+        const auto load = (float) (elapsed / (numSamples * secondsPerSample));
+        const auto smoothing = (float) jmin (1.0, numSamples * secondsPerSample);
+        cpuLoad.store (cpuLoad.load (std::memory_order_relaxed) + smoothing * (load - cpuLoad.load (std::memory_order_relaxed)),
+                       std::memory_order_relaxed);
+    }
+
+private:
+    struct Voice
+    {
+        enum State
+        {
+            idle,       // owned by the message thread
+            starting,   // handed to the audio thread, not rendered yet
+            playing,
+            stopping,   // the audio thread will fade it out and mark it finished
+            finished    // the audio thread is done with it; the message thread may reclaim it
+        };
+
+        std::atomic<int> state { idle };
+        std::atomic<float> targetGain { 0.0f };
+        std::atomic<float> speed { 1.0f };
+
+        // written by the message thread while idle, then only touched by the audio thread
+        ReferenceCountedBuffer* buffer = nullptr;
+        int loopStart = 0, loopEnd = 0;
+        double position = 0.0;
+        float currentGain = 0.0f;
+        ChannelRouting routing;
+    };
+
+    /** What one thread needs to render voices: its scratch space, its resampler, the sum of
+        what it has rendered this block and the range of tasks it has still to do.
+    */
+    struct Lane
+    {
+        AudioBuffer<float> mix, conversionScratch, resampledScratch;
+        PolyphaseResampler resampler;
+        ChannelRouting defaultRouting;      // for voices whose routing doesn't fit the output
+
+        // [begin, end) of activeVoices packed as begin << 32 | end, so taking from either end is one CAS
+        std::atomic<uint64> tasks { 0 };
+        bool usedThisBlock = false;
+    };
+
+    /** A real-time thread that spins while blocks keep coming, then parks until the audio
+        thread opens the next block to it.
+    */
+    class Worker  : public Thread
+    {
+    public:
+        Worker (LooperVoiceEngine& engineToHelp, int laneToUse)
+            : Thread ("Voice worker " + String (laneToUse)),
+              engine (engineToHelp),
+              laneIndex (laneToUse)
+        {
+        }
+
+        ~Worker() override
+        {
+            stopThread (1000);
+        }
+
+        void run() override
+        {
+            uint32 lastGeneration = 0;
+            auto lastWorkTime = Time::getMillisecondCounterHiRes();
+
+            while (! threadShouldExit())
+            {
+                const auto generation = engine.generation.load (std::memory_order_acquire);
+
+                if ((generation & 1) == 0 || generation == lastGeneration)
+                {
+                    // stay hot for a few blocks' worth of time after the last one, so the next
+                    // block finds this thread awake, but don't burn a core when the audio stops
+                    if (Time::getMillisecondCounterHiRes() - lastWorkTime < spinMilliseconds)
+                    {
+                        pause();
+                        continue;
+                    }
+
+                    // the generation is checked again after the flag is raised, so a block opened
+                    // in between either gets seen here or wakes this thread through notify()
+                    isParked.store (true);
+
+                    if (engine.generation.load() == generation)
+                        wait (-1);
+
+                    isParked.store (false);
+                    lastWorkTime = Time::getMillisecondCounterHiRes();
+                    continue;
+                }
+
+                lastGeneration = generation;
+                lastWorkTime = Time::getMillisecondCounterHiRes();
+
+                RealtimeChecker::ScopedAudioThread realtimeCheck;
+                engine.joinBlock (laneIndex, generation);
+            }
+        }
+
+        /** Called by the audio thread as it opens a block. The wake-up takes the thread's
+            event lock, but only for a worker that has gone idle, never on a block that
+            follows another one.
+        */
+        void wakeIfParked() noexcept
+        {
+            if (isParked.exchange (false))
+            {
+                const RealtimeChecker::ScopedUncheckedCall uncheckedCall;
+                notify();
+            }
+        }
+
+    private:
+        static constexpr double spinMilliseconds = 20.0;
+
+        LooperVoiceEngine& engine;
+        const int laneIndex;
+        std::atomic<bool> isParked { false };
+
+        JUCE_DECLARE_NON_COPYABLE (Worker)
+    };
+
+    static constexpr int maxOutputChannels = MixKernels::maxDestinations;
+    static constexpr double maxSpeedRatio = 4.0;
+    static constexpr int maxTapsAndSlack = 34;     // the widest kernel plus the resampler's read-ahead
+    static constexpr int minVoiceSamplesForParallelBlock = 16384;
+
+    //==============================================================================
+    void renderInParallel (AudioBuffer<float>& output, int startSample, int numSamples, int numTasks) noexcept
+    {
+        // every lane gets a share, even if its worker is asleep: the others will steal it
+        const auto numLanes = lanes.size();
+
+        for (int i = 0; i < numLanes; ++i)
+        {
+            auto& lane = *lanes.getUnchecked (i);
+            lane.tasks.store (packTasks (numTasks * i / numLanes, numTasks * (i + 1) / numLanes), std::memory_order_relaxed);
+            lane.usedThisBlock = false;
+        }
+
+        blockNumSamples = numSamples;
+        blockNumChannels = jmin (output.getNumChannels(), maxOutputChannels);
+        tasksRemaining.store (numTasks, std::memory_order_relaxed);
+
+        // an odd generation opens the block to the workers
+        const auto openGeneration = generation.load (std::memory_order_relaxed) + 1;
+        generation.store (openGeneration);
+
+        for (auto* worker : workers)
+            worker->wakeIfParked();
+
+        renderLane (0);
+
+        // the barrier: wait for any task a worker is still in the middle of
+        while (tasksRemaining.load (std::memory_order_acquire) > 0)
+            pause();
+
+        // close the block, then wait for any worker that got in before it closed to leave
+        generation.store (openGeneration + 1);
+
+        while (numParticipants.load() > 0)
+            pause();
+
+        for (int i = 0; i < numLanes; ++i)
+        {
+            const auto& lane = *lanes.getUnchecked (i);
+
+            if (lane.usedThisBlock)
+                for (int channel = 0; channel < blockNumChannels; ++channel)
+                    output.addFrom (channel, startSample, lane.mix, channel, 0, numSamples);
+        }
+    }
+
+    /** Called by a worker when it sees a new block open. */
+    void joinBlock (int laneIndex, uint32 openGeneration) noexcept
+    {
+        numParticipants.fetch_add (1);
+
+        // the block may have closed between the worker seeing it and registering; if so, keep out
+        if (generation.load() == openGeneration)
+            renderLane (laneIndex);
+
+        numParticipants.fetch_sub (1, std::memory_order_release);
+    }
+
+    void renderLane (int laneIndex) noexcept
+    {
+        auto& lane = *lanes.getUnchecked (laneIndex);
+        AudioBuffer<float> laneOutput (lane.mix.getArrayOfWritePointers(), blockNumChannels, blockNumSamples);
+        int task = 0;
+
+        while (claimTask (laneIndex, task))
+        {
+            if (! lane.usedThisBlock)
+            {
+                laneOutput.clear();
+                lane.usedThisBlock = true;
+            }
+
+            renderVoiceTask (activeVoices[task], lane, laneOutput, 0, blockNumSamples);
+            tasksRemaining.fetch_sub (1, std::memory_order_acq_rel);
+        }
+    }
+
+    /** Takes the next task from the front of this lane's share, or steals one from the back of another's. */
+    bool claimTask (int laneIndex, int& task) noexcept
+    {
+        const auto numLanes = lanes.size();
+
+        for (int i = 0; i < numLanes; ++i)
+        {
+            auto& tasks = lanes.getUnchecked ((laneIndex + i) % numLanes)->tasks;
+            const auto fromFront = i == 0;
+            auto range = tasks.load (std::memory_order_relaxed);
+
+            for (;;)
+            {
+                const auto begin = (int) (range >> 32), end = (int) (range & 0xffffffffu);
+
+                if (begin >= end)
+                    break;
+
+                const auto remaining = fromFront ? packTasks (begin + 1, end) : packTasks (begin, end - 1);
+
+                if (tasks.compare_exchange_weak (range, remaining, std::memory_order_acquire, std::memory_order_relaxed))
+                {
+                    task = fromFront ? begin : end - 1;
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    static uint64 packTasks (int begin, int end) noexcept
+    {
+        return ((uint64) (uint32) begin << 32) | (uint32) end;
+    }
+
+    static void pause() noexcept
+    {
+       #if LOOPER_MIX_AVX || LOOPER_MIX_SSE
+        _mm_pause();
+       #elif LOOPER_MIX_NEON && defined (_MSC_VER)
+        __yield();
+       #elif LOOPER_MIX_NEON
+        __asm__ __volatile__ ("yield");
+       #endif
+    }
+
+    void stopWorkers()
+    {
+        for (auto* worker : workers)
+            worker->signalThreadShouldExit();
+
+        workers.clear();
+    }
+
+    //==============================================================================
+    void renderVoiceTask (int voiceIndex, Lane& lane, AudioBuffer<float>& output, int startSample, int numSamples) noexcept
+    {
+        auto& voice = voices[(size_t) voiceIndex];
+        auto state = voice.state.load (std::memory_order_acquire);
+
+        if (state == Voice::starting)
+        {
+            // a voice that is stopped before it ever played is simply handed back
+            if (! voice.state.compare_exchange_strong (state, Voice::playing) && state == Voice::stopping)
+            {
+                voice.state.store (Voice::finished, std::memory_order_release);
+                return;
+            }
+
+            state = Voice::playing;
+        }
+
+        const auto targetGain = state == Voice::stopping ? 0.0f : voice.targetGain.load (std::memory_order_relaxed);
+        renderVoice (voice, lane, output, startSample, numSamples, targetGain);
+
+        if (state == Voice::stopping)
+            voice.state.store (Voice::finished, std::memory_order_release);
+    }
+
+    void renderVoice (Voice& voice, Lane& lane, AudioBuffer<float>& output, int startSample, int numSamples, float targetGain) noexcept
+    {
+        const auto& buffer = *voice.buffer;
+        const auto& routing = getRouting (voice, lane, output.getNumChannels());
+        const auto numInputChannels = routing.getNumInputs();
+        const auto numOutputChannels = routing.getNumOutputs();
+        const auto gainStep = (targetGain - voice.currentGain) / (float) numSamples;
+
+        const auto bufferSampleRate = buffer.getSampleRate();
+        const auto speedRatio = voice.speed.load (std::memory_order_relaxed)
+                                  * (bufferSampleRate > 0.0 ? bufferSampleRate * secondsPerSample : 1.0);
+
+        // a voice that has caught up with a buffer that is still being decoded waits for it; taps
+        // that would wrap back to its loop end before that's decoded are read as silence
+        if (! buffer.isFullyLoaded()
+             && voice.position + numSamples * speedRatio + maxTapsAndSlack >= buffer.getNumValidSamples())
+        {
+            voice.currentGain = targetGain;
+            return;
+        }
+
+        if (! approximatelyEqual (speedRatio, 1.0))
+        {
+            renderResampledVoice (voice, lane, routing, output, startSample, numSamples, speedRatio, gainStep);
+            voice.currentGain = targetGain;
+            return;
+        }
+
+        if (voice.position != std::floor (voice.position))
+        {
+            // back at the buffer's rate after a retune, but between samples: this block plays a
+            // fraction of a sample faster so that it ends on a whole one, and the fast path takes
+            // over from the next block on
+            const auto catchUpRatio = 1.0 + (std::ceil (voice.position) - voice.position) / numSamples;
+            renderResampledVoice (voice, lane, routing, output, startSample, numSamples, catchUpRatio, gainStep);
+
+            voice.position = std::round (voice.position);
+
+            if (voice.position >= voice.loopEnd)
+                voice.position = voice.loopStart;
+
+            voice.currentGain = targetGain;
+            return;
+        }
+
+        auto gain = voice.currentGain;
+        auto samplesRemaining = numSamples;
+        auto outputOffset = startSample;
+        auto position = (int) voice.position;
+
+        // voices looping the buffer's own region read through its guard, so a block never splits at the loop end
+        const auto useLoopGuard = Range<int> (voice.loopStart, voice.loopEnd) == buffer.getLoopRegion();
+
+        while (samplesRemaining > 0)
+        {
+            auto samplesThisTime = useLoopGuard ? jmin (samplesRemaining, ReferenceCountedBuffer::maxContiguousRead)
+                                                : jmin (samplesRemaining, voice.loopEnd - position);
+
+            // anything that has to be converted or unwrapped goes through the scratch buffer
+            if (buffer.needsConversionOnRead() || useLoopGuard)
+                samplesThisTime = jmin (samplesThisTime, lane.conversionScratch.getNumSamples());
+
+            const float* inputs[ChannelRouting::maxInputs];
+            float* outputs[maxOutputChannels];
+
+            for (int inputChannel = 0; inputChannel < numInputChannels; ++inputChannel)
+            {
+                const auto* source = useLoopGuard ? buffer.getLoopReadPointer (inputChannel, position, samplesThisTime)
+                                                  : buffer.getReadPointer (inputChannel, position);
+
+                if (source == nullptr)
+                {
+                    auto* scratch = lane.conversionScratch.getWritePointer (inputChannel);
+
+                    if (useLoopGuard)
+                        buffer.readLoop (inputChannel, position, scratch, samplesThisTime);
+                    else
+                        buffer.read (inputChannel, position, scratch, samplesThisTime);
+
+                    source = scratch;
+                }
+
+                inputs[inputChannel] = source;
+            }
+
+            for (int channel = 0; channel < numOutputChannels; ++channel)
+                outputs[channel] = output.getWritePointer (channel, outputOffset);
+
+            routing.process (inputs, outputs, samplesThisTime, gain, gainStep, true);
+
+            gain += gainStep * (float) samplesThisTime;
+            samplesRemaining -= samplesThisTime;
+            outputOffset += samplesThisTime;
+            position += samplesThisTime;
+
+            if (position >= voice.loopEnd)
+                position = voice.loopStart + (position - voice.loopStart) % (voice.loopEnd - voice.loopStart);
+        }
+
+        voice.position = position;
+        voice.currentGain = targetGain;
+    }
+
+    void renderResampledVoice (Voice& voice, Lane& lane, const ChannelRouting& routing, AudioBuffer<float>& output,
+                               int startSample, int numSamples, double speedRatio, float gainStep) noexcept
+    {
+        auto& resampledScratch = lane.resampledScratch;
+        const auto& buffer = *voice.buffer;
+        const auto numOutputChannels = routing.getNumOutputs();
+        const auto resamplingQuality = (ResamplingQuality) quality.load (std::memory_order_relaxed);
+
+        auto gain = voice.currentGain;
+
+        for (int done = 0; done < numSamples;)
+        {
+            const auto samplesThisTime = jmin (numSamples - done, resampledScratch.getNumSamples());
+
+            lane.resampler.process (buffer, { voice.loopStart, voice.loopEnd }, voice.position, speedRatio,
+                               resamplingQuality, resampledScratch.getArrayOfWritePointers(), samplesThisTime);
+
+            float* outputs[maxOutputChannels];
+
+            for (int channel = 0; channel < numOutputChannels; ++channel)
+                outputs[channel] = output.getWritePointer (channel, startSample + done);
+
+            routing.process (resampledScratch.getArrayOfReadPointers(), outputs, samplesThisTime, gain, gainStep, true);
+
+            gain += gainStep * (float) samplesThisTime;
+            done += samplesThisTime;
+        }
+    }
+
+    /** The voice's own routing, or the lane's default one for this shape if the voice's doesn't fit the output. */
+    static const ChannelRouting& getRouting (const Voice& voice, Lane& lane, int numOutputChannels) noexcept
+    {
+        const auto numInputChannels = voice.buffer->getNumChannels();
+
+        if (voice.routing.hasShape (numInputChannels, numOutputChannels))
+            return voice.routing;
+
+        if (! lane.defaultRouting.hasShape (numInputChannels, numOutputChannels))
+            lane.defaultRouting = ChannelRouting::createDefault (numInputChannels, numOutputChannels);
+
+        return lane.defaultRouting;
+    }
+
+    void reapFinishedVoices()
+    {
+        if (voices == nullptr)
+            return;
+
+        for (int i = 0; i < maxVoices; ++i)
+        {
+            auto& voice = voices[(size_t) i];
+
+            if (voice.state.load (std::memory_order_acquire) == Voice::finished)
+            {
+                voice.buffer = nullptr;
+                releasePool.retire (std::exchange (owners.getReference (i), nullptr));
+                voice.state.store (Voice::idle);
+            }
+        }
+    }
+
+    ReleasePool& releasePool;
+    const int maxVoices;
+
+    CriticalSection messageThreadLock;
+    std::unique_ptr<Voice[]> voices;
+    Array<ReferenceCountedBuffer::Ptr> owners;
+
+    OwnedArray<Lane> lanes;                 // the audio thread's first, then one per worker
+    OwnedArray<Worker> workers;
+    std::atomic<int> numWorkersRequested { 0 };
+
+    // the block being rendered in parallel; written by the audio thread before it opens the block
+    HeapBlock<int> activeVoices;
+    int blockNumSamples = 0, blockNumChannels = 0;
+    std::atomic<int> tasksRemaining { 0 };
+    std::atomic<uint32> generation { 0 };   // odd while a block is open to the workers
+    std::atomic<int> numParticipants { 0 };
+
+    std::atomic<int> quality { (int) ResamplingQuality::sinc16 };
+    double secondsPerSample = 1.0 / 44100.0;
+    int outputChannelsExpected = 2;
+    std::atomic<float> cpuLoad { 0.0f };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LooperVoiceEngine)
+};
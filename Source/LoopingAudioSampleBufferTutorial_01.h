@@ -47,10 +47,12 @@
 
 #pragma once
 #include "BouncingBall.h"
-#include "ReferenceCountedBuffer.h"
+#include "LooperEngine.h"
+#include "CallbackStatsOverlay.h"
 
 //==============================================================================
-class MainContentComponent   : public juce::AudioAppComponent, public juce::Timer
+class MainContentComponent   : public juce::AudioAppComponent,
+                               private juce::Timer
 {
 public:
     MainContentComponent()
@@ -63,13 +65,62 @@ public:
         clearButton.setButtonText ("Clear");
         clearButton.onClick = [this] { clearButtonClicked(); };
 
-        setSize (300, 200);
+        addAndMakeVisible (addVoiceButton);
+        addVoiceButton.setButtonText ("Add voice");
+        addVoiceButton.onClick = [this] { addVoiceButtonClicked(); };
+
+        addAndMakeVisible (mapFilesToggle);
+        mapFilesToggle.setButtonText ("Play WAV files from a memory map");
+
+        addAndMakeVisible (resamplingBox);
+        resamplingBox.addItem ("Resample when loading", 1);
+        resamplingBox.addItem ("Resample in real time: linear", 2);
+        resamplingBox.addItem ("Resample in real time: 8-tap sinc", 3);
+        resamplingBox.addItem ("Resample in real time: 16-tap sinc", 4);
+        resamplingBox.addItem ("Resample in real time: 32-tap sinc", 5);
+        resamplingBox.onChange = [this] { resamplingModeChanged(); };
+        resamplingBox.setSelectedId (1);
+
+        addAndMakeVisible (bankEntryBox);
+        bankEntryBox.setTextWhenNothingSelected ("Entry to play from a sample bank");
+        bankEntryBox.setTextWhenNoChoicesAvailable ("No sample bank open");
+        bankEntryBox.onChange = [this] { bankEntryChanged(); };
+
+        addAndMakeVisible (storageBox);
+        storageBox.addItem ("Store samples as 32-bit float", 1 + (int) SampleFormat::float32);
+        storageBox.addItem ("Store samples as 16-bit integers", 1 + (int) SampleFormat::int16);
+        storageBox.addItem ("Store samples as 16-bit float", 1 + (int) SampleFormat::float16);
+        storageBox.setSelectedId (1 + (int) SampleFormat::float32);
+
+        addAndMakeVisible (ballWindowToggle);
+        ballWindowToggle.setButtonText ("Draw the ball in its own window");
+        ballWindowToggle.onClick = [this]
+        {
+            ball.setMode (ballWindowToggle.getToggleState() ? BouncingBall::Mode::desktopWindow
+                                                            : BouncingBall::Mode::overlay);
+        };
 
-        formatManager.registerBasicFormats();
-        
-        setAudioChannels (0, 2); // [7]
-        
-        startTimer(2000);
+        addAndMakeVisible (traceOverrunsToggle);
+        traceOverrunsToggle.setButtonText ("Save a trace around each overrun");
+
+        addAndMakeVisible (saveTraceButton);
+        saveTraceButton.setButtonText ("Save trace...");
+        saveTraceButton.onClick = [this] { saveTraceButtonClicked(); };
+
+        addAndMakeVisible (statusLabel);
+        addAndMakeVisible (cacheLabel);
+        addAndMakeVisible (poolLabel);
+        addAndMakeVisible (ballLabel);
+        addAndMakeVisible (statsOverlay);
+
+        setSize (300, 500);
+
+        // leave a core for the message thread and the loaders
+        engine.getVoices().setNumWorkerThreads (jlimit (0, maxVoiceWorkers, SystemStats::getNumCpus() - 2));
+
+        setAudioChannels (0, numOutputChannels); // [7]
+
+        startTimerHz (4);
     }
     
     ~MainContentComponent() override
@@ -77,178 +128,286 @@ public:
         shutdownAudio();
     }
 
-    void prepareToPlay (int, double) override {}
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override
+    {
+        engine.prepareToPlay (samplesPerBlockExpected, sampleRate, numOutputChannels);
+    }
 
     void getNextAudioBlock (const juce::AudioSourceChannelInfo& bufferToFill) override
     {
-        /** @TODO: Problem, in steps a), b) und c) um zu veranschaulichen, wann das Problem auftritt.*/
-    
-        const auto getBufferToUse = [&](){
-            SpinLock::ScopedLockType sl{ currentBufferLock };
-            return currentBuffer;
-        };
-        
-        ReferenceCountedBuffer::Ptr bufferToUse = getBufferToUse();
+        engine.renderNextBlock (bufferToFill);
+    }
 
-        if (bufferToUse == nullptr)
-        {
-            bufferToFill.clearActiveBufferRegion();
-            return;
-        }
-        
-            
-            
-    
-        
-        // a) angenommen, wir bekommen tatsächlich in zwei Zeilen eine neue Referenz von currentBuffer
-        
-        /* b) ...   und jetzt, wo wir die Referenz haben, currentBuffer = nullptr von außen gesetzt wird und
-                    bufferToUse nun die *einzige* Referenz ist
-         */
-        
-        
-        
-        auto& fileBuffer = bufferToUse->getDataRef ();
-        
-        auto numInputChannels = fileBuffer.getNumChannels();
-        auto numOutputChannels = bufferToFill.buffer->getNumChannels();
-        
-        auto outputSamplesRemaining = bufferToFill.numSamples;                                  // [8]
-        auto outputSamplesOffset = bufferToFill.startSample;                                    // [9]
-        
-        while (outputSamplesRemaining > 0)
-        {
-            auto bufferSamplesRemaining = fileBuffer.getNumSamples() - position;                // [10]
-            auto samplesThisTime = juce::jmin (outputSamplesRemaining, bufferSamplesRemaining); // [11]
-
-            for (auto channel = 0; channel < numOutputChannels; ++channel)
-            {
-                bufferToFill.buffer->copyFrom (channel,                                         // [12]
-                                               outputSamplesOffset,                             //  [12.1]
-                                               fileBuffer,                                      //  [12.2]
-                                               channel % numInputChannels,                      //  [12.3]
-                                               position,                                        //  [12.4]
-                                               samplesThisTime);                                //  [12.5]
-            }
-
-            outputSamplesRemaining -= samplesThisTime;                                          // [13]
-            outputSamplesOffset += samplesThisTime;                                             // [14]
-            position += samplesThisTime;                                                        // [15]
-
-            if (position == fileBuffer.getNumSamples())
-                position = 0;                                                                   // [16]
-        }
-        
-        
-        /** c)      ... und nun die letzte Referenz (bufferToUse) out of scope geht
-                wird nun der gesamt ReferenceCountedBuffer **gelöscht** und zwar auf dem AudioThread.
-                Ditte darf nicht passieren.
-         
-                **Wie könnte man das lösen?**
-         */
+    /** The audio callback's timing figures, e.g. for logging. Safe to call from any thread but the audio thread. */
+    CallbackStats::Snapshot getCallbackStats() const
+    {
+        return engine.getCallbackStats();
     }
 
     void releaseResources() override
     {
-        SpinLock::ScopedLockType slt{ currentBufferLock };
-        currentBuffer = nullptr;
+        engine.releaseResources();
     }
 
     void resized() override
     {
-        openButton .setBounds (10, 10, getWidth() - 20, 20);
-        clearButton.setBounds (10, 40, getWidth() - 20, 20);
+        openButton    .setBounds (10, 10, getWidth() - 20, 20);
+        bankEntryBox  .setBounds (10, 40, getWidth() - 20, 20);
+        clearButton   .setBounds (10, 70, getWidth() - 20, 20);
+        addVoiceButton.setBounds (10, 100, getWidth() - 20, 20);
+        mapFilesToggle.setBounds (10, 130, getWidth() - 20, 20);
+        resamplingBox .setBounds (10, 160, getWidth() - 20, 20);
+        storageBox    .setBounds (10, 190, getWidth() - 20, 20);
+        ballWindowToggle.setBounds (10, 220, getWidth() - 20, 20);
+        traceOverrunsToggle.setBounds (10, 250, getWidth() - 20, 20);
+        saveTraceButton.setBounds (10, 280, getWidth() - 20, 20);
+        statusLabel   .setBounds (10, 310, getWidth() - 20, 20);
+        cacheLabel    .setBounds (10, 340, getWidth() - 20, 20);
+        poolLabel     .setBounds (10, 370, getWidth() - 20, 20);
+        ballLabel     .setBounds (10, 400, getWidth() - 20, 20);
+        statsOverlay  .setBounds (getLocalBounds().removeFromBottom (60));
     }
 
 private:
     BouncingBall ball { *this };
     
+    void resamplingModeChanged()
+    {
+        auto id = resamplingBox.getSelectedId();
+        auto quality = id <= 1 ? ResamplingQuality::sinc16 : (ResamplingQuality) (id - 2);
+
+        // even when converting on load, mapped files and anything loaded before the device
+        // started still need converting on the fly, so keep a sensible quality for those
+        resampleWhenLoading = id <= 1;
+        engine.setResamplingQuality (quality);
+    }
+
     void openButtonClicked()
     {
-        chooser = std::make_unique<juce::FileChooser> ("Select a Wave file shorter than 2 seconds to play...",
+        chooser = std::make_unique<juce::FileChooser> ("Select a Wave file or sample bank to play (any more are preloaded)...",
                                                        juce::File{},
-                                                       "*.wav");
+                                                       "*.wav;*.bank");
         
         auto chooserFlags = juce::FileBrowserComponent::openMode
-                          | juce::FileBrowserComponent::canSelectFiles;
+                          | juce::FileBrowserComponent::canSelectFiles
+                          | juce::FileBrowserComponent::canSelectMultipleItems;
 
         chooser->launchAsync (chooserFlags, [this] (const juce::FileChooser& fc)
         {
-            auto file = fc.getResult();
+            auto files = fc.getResults();
 
-            if (file == juce::File{})
+            if (files.isEmpty())
                 return;
 
-            
-            auto lambda = [/*capture list*/] (/*arguments*/) {/* function body */ };
-            
-            threads.addJob ([&, file]()
-            {
-                std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (file)); // [2]
-
-                jassert (reader.get() != nullptr);
-                if (reader.get() != nullptr)
-                {
-                    auto duration = (float) reader->lengthInSamples / reader->sampleRate;           // [3]
-
-                    ReferenceCountedBuffer::Ptr newBuffer = new ReferenceCountedBuffer (file.getFileNameWithoutExtension(), reader->numChannels, reader->lengthInSamples);
-
-                    reader->read (&newBuffer->getDataRef(),                                                      // [5]
-                                  0,                                                                //  [5.1]
-                                  (int) reader->lengthInSamples,                                    //  [5.2]
-                                  0,                                                                //  [5.3]
-                                  true,                                                             //  [5.4]
-                                  true);                                                            //  [5.5]
-                    position = 0;                                                                   // [6]
-                    
-                    // add newBuffer to array to ensure that we have at least two references to our buffer
-                    buffers.add (newBuffer);
-                    
-                    // lock the currentBufferLock to ensure that audio thread is not getting the reference at the same time
-                    SpinLock::ScopedLockType slt{ currentBufferLock };
-                    currentBuffer = newBuffer;
-                }
-            });
-            
-            
-            
+            auto settings = getLoadSettings();
+
+            // the first file supersedes anything still loading to play; the others only warm the cache
+            engine.playFile (files.getFirst(), settings);
+            listBankEntries (files.getFirst());
+
+            for (int i = 1; i < files.size(); ++i)
+                engine.preloadFile (files[i], settings);
         });
     }
 
+    LooperEngine::LoadSettings getLoadSettings() const
+    {
+        LooperEngine::LoadSettings settings;
+        settings.mapWavFiles = mapFilesToggle.getToggleState();
+        settings.convertSampleRate = resampleWhenLoading.load();
+        settings.storageFormat = (SampleFormat) (storageBox.getSelectedId() - 1);
+        return settings;
+    }
+
+    /** Fills the entry picker from a sample bank's index, with the first entry (the one that
+        plays on opening) selected, or empties it for any other file.
+    */
+    void listBankEntries (const juce::File& file)
+    {
+        bankEntryBox.clear (dontSendNotification);
+        bankFile = juce::File{};
+
+        // opening a bank only maps it and reads its index, so it's quick enough for the message thread
+        auto bank = file.hasFileExtension ("bank") ? SampleBank::open (file) : nullptr;
+
+        if (bank == nullptr)
+            return;
+
+        for (int i = 0; i < bank->getNumEntries(); ++i)
+            bankEntryBox.addItem (bank->getEntry (i).name, i + 1);
+
+        bankFile = file;
+        bankEntryBox.setSelectedId (1, dontSendNotification);
+    }
+
+    void bankEntryChanged()
+    {
+        auto entry = bankEntryBox.getSelectedId() - 1;
+
+        if (bankFile != juce::File{} && entry >= 0)
+            engine.playFile (bankFile, getLoadSettings(), entry);
+    }
+
     void clearButtonClicked()
     {
-        SpinLock::ScopedLockType slt{ currentBufferLock };
-        currentBuffer = nullptr;
+        engine.clear();
     }
-    
-    void timerCallback () override
+
+    void addVoiceButtonClicked()
+    {
+        // layers another loop of the current buffer, starting somewhere random
+        if (auto buffer = engine.getCurrentBuffer())
+            engine.getVoices().startVoice (buffer, 0.25f, {}, random.nextInt (buffer->getNumSamples()));
+    }
+
+    static String getSampleFormatName (SampleFormat format)
     {
-        // iterate over buffers and check for getReferenceCount () <= 1
-        // remove buffers from array in case its unused
-        for (int i = buffers.size (); --i >= 0;)
+        switch (format)
         {
-            auto ptr = buffers.getUnchecked(i);
-            
-            if (ptr->getReferenceCount() <= 2)
-                buffers.remove (i);
+            case SampleFormat::int16:   return "int16";
+            case SampleFormat::float16: return "float16";
+            case SampleFormat::float32:
+            default:                    return "float32";
         }
     }
 
-    ThreadPool threads;
-    
+    void saveTraceButtonClicked()
+    {
+        chooser = std::make_unique<juce::FileChooser> ("Save a trace for chrome://tracing or Perfetto...",
+                                                       juce::File::getSpecialLocation (juce::File::userDocumentsDirectory)
+                                                           .getChildFile ("Looper trace.json"),
+                                                       "*.json");
+
+        auto chooserFlags = juce::FileBrowserComponent::saveMode
+                          | juce::FileBrowserComponent::warnAboutOverwriting;
+
+        chooser->launchAsync (chooserFlags, [this] (const juce::FileChooser& fc)
+        {
+            auto file = fc.getResult();
+
+            if (file != juce::File{})
+                saveTrace (file, 0.0);
+        });
+    }
+
+    /** Writes the last so many seconds of the trace (0 for all of it) from the thread pool, as
+        formatting a full one takes a moment.
+    */
+    void saveTrace (const juce::File& file, double lastSeconds)
+    {
+        engine.getThreadPool().addJob ([recorder = trace, file, lastSeconds]
+        {
+            recorder->writeChromeJson (file, lastSeconds);
+        });
+    }
+
+    /** With the toggle on, saves the trace shortly after a callback overruns, so that it shows
+        what led up to the overrun and what followed, at most once every so often.
+    */
+    void saveTraceAfterOverrun (uint64 numOverruns)
+    {
+        const auto now = juce::Time::getMillisecondCounter();
+
+        // the count starts again from zero when the device is restarted
+        const auto isNewOverrun = numOverruns > numOverrunsSeen;
+        numOverrunsSeen = numOverruns;
+
+        if (isNewOverrun && traceOverrunsToggle.getToggleState() && overrunTraceDue == 0
+             && (lastOverrunTrace == 0 || now - lastOverrunTrace >= minMsBetweenOverrunTraces))
+            overrunTraceDue = now + overrunTraceDelayMs;
+
+        if (overrunTraceDue != 0 && now >= overrunTraceDue)
+        {
+            overrunTraceDue = 0;
+            lastOverrunTrace = now;
+
+            auto folder = juce::File::getSpecialLocation (juce::File::userDocumentsDirectory).getChildFile ("Looper traces");
+            folder.createDirectory();
+            saveTrace (folder.getChildFile ("Overrun " + juce::Time::getCurrentTime().formatted ("%Y-%m-%d %H-%M-%S") + ".json"),
+                       overrunTraceSeconds);
+        }
+    }
+
+    void timerCallback() override
+    {
+        trace->nameCurrentThread ("Message");
+        const TraceRecorder::Span span { *trace, "timerCallback" };
+
+        auto& voices = engine.getVoices();
+        voices.releaseFinishedVoices();
+
+        if (auto stream = engine.getCurrentStream())
+            statusLabel.setText ("Streaming " + stream->getName()
+                                   + ", " + String (stream->getWindowSizeInBytes() / 1024) + " KB window"
+                                   + ", underruns: " + String (stream->getNumUnderruns()),
+                                 dontSendNotification);
+        else if (auto numVoices = voices.getNumActiveVoices())
+            statusLabel.setText (String (numVoices) + " voices, "
+                                   + String (roundToInt (voices.getCpuLoad() * 100.0f)) + "% of the block time",
+                                 dontSendNotification);
+        else if (auto buffer = engine.getCurrentBuffer())
+            statusLabel.setText (buffer->getName() + ": " + String ((double) buffer->getSizeInBytes() / (1024.0 * 1024.0), 1)
+                                   + " MB" + (buffer->isMemoryMapped() ? String (", memory-mapped") : " as " + getSampleFormatName (buffer->getSampleFormat())),
+                                 dontSendNotification);
+        else
+            statusLabel.setText ({}, dontSendNotification);
+
+        auto cacheStats = sampleCache->getStatistics();
+        auto poolStats = sampleMemory->getStatistics();
+        cacheLabel.setText ("Cache: " + String (cacheStats.numBuffers) + " buffers, "
+                              + String ((double) cacheStats.bytesInUse / (1024.0 * 1024.0), 1) + " MB, "
+                              + String (cacheStats.hits) + " hits, " + String (cacheStats.misses) + " misses",
+                            dontSendNotification);
+
+        auto numOutOfMemory = engine.getNumOutOfMemoryLoads();
+        poolLabel.setText ("Sample memory: " + String ((double) poolStats.bytesInUse / (1024.0 * 1024.0), 1) + " MB in use, "
+                             + String ((double) poolStats.bytesRetained / (1024.0 * 1024.0), 1) + " MB spare, "
+                             + String (poolStats.reuses) + "/" + String (poolStats.allocations) + " reused"
+                             + (numOutOfMemory > 0 ? ", out of memory for " + String (numOutOfMemory) + " loads" : String()),
+                           dontSendNotification);
+
+        auto ballCost = ball.getFrameCost();
+        ballLabel.setText ("Ball: " + String (ballCost.averageMs, 3) + " ms/frame on the message thread, max "
+                             + String (ballCost.maxMs, 3) + " ms, " + String (ballCost.numFrames) + " frames",
+                           dontSendNotification);
+
+        const auto callbackSnapshot = engine.getCallbackStats();
+        statsOverlay.update (callbackSnapshot);
+        saveTraceAfterOverrun (callbackSnapshot.numOverruns);
+    }
+
     //==========================================================================
     juce::TextButton openButton;
     juce::TextButton clearButton;
+    juce::TextButton addVoiceButton;
+    juce::TextButton saveTraceButton;
+    juce::ToggleButton mapFilesToggle, ballWindowToggle, traceOverrunsToggle;
+    juce::ComboBox resamplingBox, storageBox, bankEntryBox;
+    juce::Label statusLabel, cacheLabel, poolLabel, ballLabel;
+    CallbackStatsOverlay statsOverlay;
 
     std::unique_ptr<juce::FileChooser> chooser;
+    juce::File bankFile;        // the sample bank bankEntryBox lists, if one is open
 
-    juce::AudioFormatManager formatManager;
+    SharedResourcePointer<SampleMemoryPool> sampleMemory;
+    SharedResourcePointer<SampleCache> sampleCache;
+    SharedResourcePointer<TraceRecorder> trace;
 
-    int position;
+    std::atomic<bool> resampleWhenLoading { true };
+
+    // beyond this many helpers, the per-block hand-off costs more than another core saves
+    static constexpr int maxVoiceWorkers = 7;
+    static constexpr int numOutputChannels = 2;
+
+    // an overrun's trace covers this long before it and is saved this long after it
+    static constexpr double overrunTraceSeconds = 3.0;
+    static constexpr uint32 overrunTraceDelayMs = 500, minMsBetweenOverrunTraces = 30000;
+
+    uint64 numOverrunsSeen = 0;
+    uint32 overrunTraceDue = 0, lastOverrunTrace = 0;
+
+    LooperEngine engine;
+    Random random;
 
-    ReferenceCountedBuffer::Ptr currentBuffer;
-    SpinLock currentBufferLock;
-    ReferenceCountedArray<ReferenceCountedBuffer> buffers;
-    
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainContentComponent)
 };
@@ -46,9 +46,12 @@
 
 
 #pragma once
+#include "MixKernels.h"
+#include "SpscQueue.h"
 
 //==============================================================================
-class MainContentComponent   : public juce::AudioAppComponent
+class MainContentComponent   : public juce::AudioAppComponent,
+                               private juce::Timer
 {
 public:
     MainContentComponent()
@@ -63,63 +66,85 @@ public:
 
         addAndMakeVisible (levelSlider);
         levelSlider.setRange (0.0, 1.0);
-        levelSlider.onValueChange = [this] { currentLevel = (float) levelSlider.getValue(); };
+        levelSlider.onValueChange = [this] { sendLevel(); };
 
         setSize (300, 200);
 
         formatManager.registerBasicFormats();
+
+        // the device stays open from here on; loading and clearing are commands to the audio thread
+        setAudioChannels (0, 2);
+        startTimerHz (10);
     }
 
     ~MainContentComponent() override
     {
         shutdownAudio();
+        stopTimer();
+
+        // the audio thread has stopped, so everything it owned can be freed here
+        Command command;
+
+        while (commands.pop (command))
+            delete command.buffer;
+
+        delete pendingSwitch.buffer;
+        delete fileBuffer;
+        collectRetiredBuffers();
     }
 
-    void prepareToPlay (int, double) override {}
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override
+    {
+        level.reset (sampleRate, levelRampSeconds);
+        switchFadeLength = juce::jmax (1, juce::roundToInt (sampleRate * switchFadeSeconds));
+
+        deviceSampleRate.store (sampleRate);
+        deviceBlockSize.store (samplesPerBlockExpected);
+    }
 
     void getNextAudioBlock (const juce::AudioSourceChannelInfo& bufferToFill) override
     {
-        auto level = currentLevel;
-        auto startLevel = juce::approximatelyEqual (level, previousLevel) ? level : previousLevel;
+        const auto blockStart = sampleTime;
+        publishClock (blockStart);
 
-        auto numInputChannels = fileBuffer.getNumChannels();
-        auto numOutputChannels = bufferToFill.buffer->getNumChannels();
+        auto done = 0;
 
-        auto outputSamplesRemaining = bufferToFill.numSamples;
-        auto outputSamplesOffset = bufferToFill.startSample;
-
-        while (outputSamplesRemaining > 0)
+        while (done < bufferToFill.numSamples)
         {
-            auto bufferSamplesRemaining = fileBuffer.getNumSamples() - position;
-            auto samplesThisTime = juce::jmin (outputSamplesRemaining, bufferSamplesRemaining);
-
-            for (auto channel = 0; channel < numOutputChannels; ++channel)
+            // everything due by this sample takes effect here, except that nothing overtakes a
+            // switch that is still fading out: the commands behind it wait until it has happened
+            while (! switchPending)
             {
-                bufferToFill.buffer->copyFrom (channel,
-                                               outputSamplesOffset,
-                                               fileBuffer,
-                                               channel % numInputChannels,
-                                               position,
-                                               samplesThisTime);
-
-                bufferToFill.buffer->applyGainRamp (channel, outputSamplesOffset, samplesThisTime, startLevel, level);
+                auto* command = commands.peek();
+
+                if (command == nullptr || command->sampleTime > blockStart + done)
+                    break;
+
+                applyCommand (*command);
+                commands.pop();
             }
 
-            outputSamplesRemaining -= samplesThisTime;
-            outputSamplesOffset += samplesThisTime;
-            position += samplesThisTime;
+            // render up to the next command, or the end of a switch fade, whichever comes first
+            auto segmentEnd = bufferToFill.numSamples;
 
-            if (position == fileBuffer.getNumSamples())
-                position = 0;
+            if (! switchPending)
+                if (auto* next = commands.peek())
+                    segmentEnd = (int) juce::jmin ((juce::int64) segmentEnd, next->sampleTime - blockStart);
+
+            if (switchFadeRemaining > 0)
+                segmentEnd = juce::jmin (segmentEnd, done + switchFadeRemaining);
+
+            renderSegment (bufferToFill, done, segmentEnd - done);
+            done = segmentEnd;
+
+            if (switchFadeRemaining == 0 && switchPending)
+                finishSwitch();
         }
 
-        previousLevel = level;
+        sampleTime += bufferToFill.numSamples;
     }
 
-    void releaseResources() override
-    {
-        fileBuffer.setSize (0, 0);
-    }
+    void releaseResources() override {}
 
     void resized() override
     {
@@ -128,11 +153,54 @@ public:
         levelSlider.setBounds (10, 70, getWidth() - 20, 20);
     }
 
+    /** Moves playback to a sample in the current buffer. Message thread only. */
+    void seek (int newPosition)
+    {
+        Command command;
+        command.type = Command::Type::seek;
+        command.position = newPosition;
+        sendCommand (command);
+    }
+
+    /** Loops [start, end) of the current buffer, or all of it if that's empty. Message thread only. */
+    void setLoopRegion (int start, int end)
+    {
+        Command command;
+        command.type = Command::Type::setLoopRegion;
+        command.loopStart = start;
+        command.loopEnd = end;
+        sendCommand (command);
+    }
+
 private:
-    void openButtonClicked()
+    /** A change for the audio thread to make at a given point on its sample clock. */
+    struct Command
     {
-        shutdownAudio();                                                                            // [1]
+        enum class Type
+        {
+            load,           // play buffer, which the audio thread then owns
+            clear,
+            setLevel,
+            seek,
+            setLoopRegion   // [loopStart, loopEnd), or the whole buffer if that's empty
+        };
+
+        Type type = Type::clear;
+        juce::int64 sampleTime = 0;
+        juce::AudioSampleBuffer* buffer = nullptr;
+        float level = 0.0f;
+        int position = 0, loopStart = 0, loopEnd = 0;
+    };
+
+    static constexpr int queueSize = 64;
+
+    // a load, clear or seek fades out, takes effect in silence, then fades back in
+    static constexpr double switchFadeSeconds = 0.005;
+    static constexpr double levelRampSeconds = 0.05;
 
+    //==========================================================================
+    void openButtonClicked()
+    {
         chooser = std::make_unique<juce::FileChooser> ("Select a Wave file shorter than 2 seconds to play...",
                                                        juce::File{},
                                                        "*.wav");
@@ -154,15 +222,25 @@ private:
 
                 if (duration < 2)
                 {
-                    fileBuffer.setSize ((int) reader->numChannels, (int) reader->lengthInSamples);  // [4]
-                    reader->read (&fileBuffer,                                                      // [5]
+                    auto newBuffer = std::make_unique<juce::AudioSampleBuffer> ((int) reader->numChannels,
+                                                                                (int) reader->lengthInSamples); // [4]
+                    reader->read (newBuffer.get(),                                                  // [5]
                                   0,                                                                //  [5.1]
                                   (int) reader->lengthInSamples,                                    //  [5.2]
                                   0,                                                                //  [5.3]
                                   true,                                                             //  [5.4]
                                   true);                                                            //  [5.5]
-                    position = 0;                                                                   // [6]
-                    setAudioChannels (0, (int) reader->numChannels);                                // [7]
+
+                    // the audio thread switches to it without the device stopping                 // [6]
+                    Command command;
+                    command.type = Command::Type::load;
+                    command.buffer = newBuffer.get();
+
+                    if (buffersInFlight < retiredBuffers.getCapacity() && sendCommand (command))
+                    {
+                        newBuffer.release();
+                        ++buffersInFlight;
+                    }
                 }
                 else
                 {
@@ -174,7 +252,277 @@ private:
 
     void clearButtonClicked()
     {
-        shutdownAudio();
+        Command command;
+        command.type = Command::Type::clear;
+        sendCommand (command);
+    }
+
+    void sendLevel()
+    {
+        Command command;
+        command.type = Command::Type::setLevel;
+        command.level = (float) levelSlider.getValue();
+
+        // if the queue is full, the timer tries again
+        levelNeedsSending = ! sendCommand (command);
+    }
+
+    /** Stamps a command with the sample time it should take effect at and queues it. */
+    bool sendCommand (Command command)
+    {
+        command.sampleTime = getSampleTimeForNow();
+        return commands.push (command);
+    }
+
+    void timerCallback() override
+    {
+        collectRetiredBuffers();
+
+        if (levelNeedsSending)
+            sendLevel();
+    }
+
+    void collectRetiredBuffers()
+    {
+        juce::AudioSampleBuffer* buffer = nullptr;
+
+        while (retiredBuffers.pop (buffer))
+        {
+            delete buffer;
+            --buffersInFlight;
+        }
+    }
+
+    //==========================================================================
+    /** Publishes the sample time and wall-clock time of the block that's starting, so that
+        the message thread can stamp commands with the sample they happened at.
+    */
+    void publishClock (juce::int64 blockStart) noexcept
+    {
+        clockSequence.fetch_add (1);   // odd while the pair is being written
+        clockSampleTime.store (blockStart);
+        clockTicks.store (juce::Time::getHighResolutionTicks());
+        clockSequence.fetch_add (1);
+    }
+
+    /** The sample time a command sent now should take effect at: where the audio clock is
+        now, plus one block. Stamping commands this way delays them all by the same amount
+        instead of rounding each one to whichever block boundary comes next.
+    */
+    juce::int64 getSampleTimeForNow() const
+    {
+        juce::int64 blockStart = 0, blockTicks = 0;
+
+        for (;;)
+        {
+            const auto sequence = clockSequence.load();
+
+            if ((sequence & 1) != 0)
+                continue;
+
+            blockStart = clockSampleTime.load();
+            blockTicks = clockTicks.load();
+
+            if (clockSequence.load() == sequence)
+                break;
+        }
+
+        // before the first block, do it as soon as the audio starts
+        if (blockTicks == 0)
+            return 0;
+
+        const auto blockSize = deviceBlockSize.load();
+        const auto elapsedSeconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - blockTicks);
+
+        // if the callbacks have stalled, don't stamp anything later than the block after next
+        const auto elapsed = juce::jmin ((juce::int64) blockSize, (juce::int64) (elapsedSeconds * deviceSampleRate.load()));
+
+        return blockStart + elapsed + blockSize;
+    }
+
+    //==========================================================================
+    void applyCommand (const Command& command) noexcept
+    {
+        switch (command.type)
+        {
+            case Command::Type::setLevel:
+                level.setTargetValue (command.level);
+                break;
+
+            case Command::Type::setLoopRegion:
+            {
+                auto region = getClampedLoopRegion (command.loopStart, command.loopEnd);
+
+                // moving the region out from under the playback position would click, so that
+                // goes through a switch like a seek
+                if (position >= region.getStart() && position < region.getEnd())
+                {
+                    loopStart = region.getStart();
+                    loopEnd = region.getEnd();
+                }
+                else
+                {
+                    beginSwitch (command);
+                }
+
+                break;
+            }
+
+            case Command::Type::load:
+            case Command::Type::clear:
+            case Command::Type::seek:
+            default:
+                beginSwitch (command);
+                break;
+        }
+    }
+
+    void beginSwitch (const Command& command) noexcept
+    {
+        jassert (! switchPending);
+
+        pendingSwitch = command;
+        switchPending = true;
+        startSwitchFade (0.0f);
+
+        if (switchFadeRemaining == 0)
+            finishSwitch();
+    }
+
+    /** Makes the pending switch now that the output has faded to silence, and fades back in. */
+    void finishSwitch() noexcept
+    {
+        switchPending = false;
+
+        switch (pendingSwitch.type)
+        {
+            case Command::Type::load:
+                retire (fileBuffer);
+                fileBuffer = pendingSwitch.buffer;
+                loopStart = 0;
+                loopEnd = fileBuffer->getNumSamples();
+                position = 0;
+                break;
+
+            case Command::Type::clear:
+                retire (fileBuffer);
+                fileBuffer = nullptr;
+                break;
+
+            case Command::Type::seek:
+                position = juce::jlimit (loopStart, juce::jmax (loopStart, loopEnd - 1), pendingSwitch.position);
+                break;
+
+            case Command::Type::setLoopRegion:
+            {
+                auto region = getClampedLoopRegion (pendingSwitch.loopStart, pendingSwitch.loopEnd);
+                loopStart = region.getStart();
+                loopEnd = region.getEnd();
+                position = loopStart;
+                break;
+            }
+
+            case Command::Type::setLevel:
+            default:
+                jassertfalse;
+                break;
+        }
+
+        pendingSwitch = {};
+
+        if (fileBuffer != nullptr)
+            startSwitchFade (1.0f);
+    }
+
+    void startSwitchFade (float target) noexcept
+    {
+        switchFadeRemaining = juce::roundToInt (std::abs (target - switchGain) * (float) switchFadeLength);
+        switchGainStep = switchFadeRemaining > 0 ? (target - switchGain) / (float) switchFadeRemaining : 0.0f;
+
+        if (switchFadeRemaining == 0)
+            switchGain = target;
+    }
+
+    /** The part of [start, end) inside the current buffer, or the whole buffer if that's empty. */
+    juce::Range<int> getClampedLoopRegion (int start, int end) const noexcept
+    {
+        auto length = fileBuffer != nullptr ? fileBuffer->getNumSamples() : 0;
+        auto region = juce::Range<int> (start, end).getIntersectionWith ({ 0, length });
+
+        return region.isEmpty() ? juce::Range<int> (0, length) : region;
+    }
+
+    /** Hands a buffer the audio thread no longer needs back to the message thread to be freed. */
+    void retire (juce::AudioSampleBuffer* buffer) noexcept
+    {
+        if (buffer == nullptr)
+            return;
+
+        // there's always room: the message thread never has more buffers out than the queue holds
+        auto pushed = retiredBuffers.push (buffer);
+        jassert (pushed);
+        juce::ignoreUnused (pushed);
+    }
+
+    void renderSegment (const juce::AudioSourceChannelInfo& bufferToFill, int offset, int numSamples) noexcept
+    {
+        // one ramp across the whole segment, so a loop wrap in the middle doesn't restart it
+        auto startGain = level.getCurrentValue() * switchGain;
+        level.skip (numSamples);
+
+        switchGain += switchGainStep * (float) numSamples;
+        switchFadeRemaining -= juce::jmin (switchFadeRemaining, numSamples);
+
+        if (switchFadeRemaining == 0)
+        {
+            switchGain = switchGainStep < 0.0f ? 0.0f : (switchGainStep > 0.0f ? 1.0f : switchGain);
+            switchGainStep = 0.0f;
+        }
+
+        auto endGain = level.getCurrentValue() * switchGain;
+
+        if (fileBuffer == nullptr || loopEnd <= loopStart)
+        {
+            bufferToFill.buffer->clear (bufferToFill.startSample + offset, numSamples);
+            return;
+        }
+
+        auto gainStep = (endGain - startGain) / (float) numSamples;
+        auto gain = startGain;
+
+        auto numInputChannels = fileBuffer->getNumChannels();
+        auto numOutputChannels = bufferToFill.buffer->getNumChannels();
+
+        auto outputSamplesRemaining = numSamples;
+        auto outputSamplesOffset = bufferToFill.startSample + offset;
+
+        while (outputSamplesRemaining > 0)
+        {
+            auto bufferSamplesRemaining = loopEnd - position;
+            auto samplesThisTime = juce::jmin (outputSamplesRemaining, bufferSamplesRemaining);
+
+            for (auto inputChannel = 0; inputChannel < juce::jmin (numInputChannels, numOutputChannels); ++inputChannel)
+            {
+                // copy, apply the gain and fan out to every output fed by this input in one pass
+                float* dests[MixKernels::maxDestinations];
+                auto numDests = 0;
+
+                for (auto channel = inputChannel; channel < numOutputChannels && numDests < MixKernels::maxDestinations; channel += numInputChannels)
+                    dests[numDests++] = bufferToFill.buffer->getWritePointer (channel, outputSamplesOffset);
+
+                MixKernels::copyWithRamp (dests, numDests,
+                                          fileBuffer->getReadPointer (inputChannel, position),
+                                          samplesThisTime, gain, gainStep);
+            }
+
+            gain += gainStep * (float) samplesThisTime;
+            outputSamplesRemaining -= samplesThisTime;
+            outputSamplesOffset += samplesThisTime;
+            position += samplesThisTime;
+
+            if (position == loopEnd)
+                position = loopStart;
+        }
     }
 
     //==========================================================================
@@ -185,10 +533,29 @@ private:
     std::unique_ptr<juce::FileChooser> chooser;
 
     juce::AudioFormatManager formatManager;
-    juce::AudioSampleBuffer fileBuffer;
-    int position = 0;
 
-    float currentLevel = 0.0f, previousLevel = 0.0f;
+    // message thread -> audio thread, and the buffers coming back to be freed
+    SpscQueue<Command, queueSize> commands;
+    SpscQueue<juce::AudioSampleBuffer*, queueSize> retiredBuffers;
+    int buffersInFlight = 0;
+    bool levelNeedsSending = false;
+
+    // the audio thread's clock, for stamping commands
+    std::atomic<juce::uint32> clockSequence { 0 };
+    std::atomic<juce::int64> clockSampleTime { 0 }, clockTicks { 0 };
+    std::atomic<double> deviceSampleRate { 44100.0 };
+    std::atomic<int> deviceBlockSize { 512 };
+
+    // audio thread only
+    juce::AudioSampleBuffer* fileBuffer = nullptr;
+    int position = 0, loopStart = 0, loopEnd = 0;
+    juce::int64 sampleTime = 0;
+    juce::SmoothedValue<float> level { 0.0f };
+
+    Command pendingSwitch;
+    bool switchPending = false;
+    float switchGain = 0.0f, switchGainStep = 0.0f;
+    int switchFadeLength = 1, switchFadeRemaining = 0;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainContentComponent)
 };
@@ -0,0 +1,230 @@
+/*
+  ==============================================================================
+
+    MappedWavFile.h
+    Created: 16 Oct 2026 10:43:41pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_LINUX || JUCE_MAC || JUCE_BSD || JUCE_ANDROID
+ #include <sys/mman.h>
+#endif
+
+/** A read-only memory-mapped view of the sample data in an uncompressed WAV file.
+
+    Nothing is decoded up front: samples are converted to float while they are copied
+    out, and the pages themselves live in the OS page cache, where they are shared with
+    every other process (or buffer) mapping the same file.
+
+    A TimeSliceThread asks the OS to page in the region ahead of the last position the
+    audio thread read from, and the start of the file ahead of the loop wrap, so that
+    the audio thread doesn't take page faults in the common case.
+*/
+class MappedWavFile  : private TimeSliceClient
+{
+public:
+    /** Maps the given file, or returns nullptr if it isn't a PCM (16/24/32 bit) or
+        32-bit float WAV file that can be played straight from the mapping.
+    */
+    static std::unique_ptr<MappedWavFile> open (const File& file, TimeSliceThread& prefetchThread)
+    {
+        auto map = std::make_unique<MemoryMappedFile> (file, MemoryMappedFile::readOnly);
+
+        if (map->getData() == nullptr)
+            return {};
+
+        auto layout = parseHeader (static_cast<const char*> (map->getData()), map->getSize());
+
+        if (! layout.isValid())
+            return {};
+
+        return std::unique_ptr<MappedWavFile> (new MappedWavFile (std::move (map), layout, prefetchThread));
+    }
+
+    ~MappedWavFile() override
+    {
+        thread.removeTimeSliceClient (this);
+    }
+
+    int getNumChannels() const noexcept     { return layout.numChannels; }
+    int getNumSamples() const noexcept      { return layout.numSamples; }
+    double getSampleRate() const noexcept   { return layout.sampleRate; }
+
+    /** Converts samples from one channel of the mapping into dest. Safe to call on the audio thread. */
+    void read (int channel, int startSample, float* dest, int numSamples) const noexcept
+    {
+        jassert (isPositiveAndBelow (channel, layout.numChannels));
+        jassert (startSample >= 0 && startSample + numSamples <= layout.numSamples);
+
+        const auto* source = sampleData + (size_t) startSample * (size_t) layout.bytesPerFrame
+                                        + (size_t) channel * (size_t) layout.bytesPerSample;
+
+        switch (layout.encoding)
+        {
+            case Encoding::int16:   convert<AudioData::Int16>   (source, dest, numSamples); break;
+            case Encoding::int24:   convert<AudioData::Int24>   (source, dest, numSamples); break;
+            case Encoding::int32:   convert<AudioData::Int32>   (source, dest, numSamples); break;
+            case Encoding::float32: convert<AudioData::Float32> (source, dest, numSamples); break;
+            case Encoding::unsupported:
+            default:                jassertfalse; break;
+        }
+
+        lastReadPosition.store (startSample + numSamples, std::memory_order_relaxed);
+    }
+
+    /** Hints to the OS that the given range of frames will be needed soon. Not for the audio thread. */
+    void prefetch (int startSample, int numSamples) const noexcept
+    {
+        startSample = jlimit (0, layout.numSamples, startSample);
+        numSamples = jlimit (0, layout.numSamples - startSample, numSamples);
+
+        if (numSamples == 0)
+            return;
+
+        const auto mapStart = reinterpret_cast<uintptr_t> (map->getData());
+        auto first = reinterpret_cast<uintptr_t> (sampleData) + (uintptr_t) startSample * (uintptr_t) layout.bytesPerFrame;
+        auto last = first + (uintptr_t) numSamples * (uintptr_t) layout.bytesPerFrame;
+
+        first = jmax (mapStart, first & ~(uintptr_t) (pageSize - 1));
+
+       #if JUCE_LINUX || JUCE_MAC || JUCE_BSD || JUCE_ANDROID
+        ::madvise (reinterpret_cast<void*> (first), (size_t) (last - first), MADV_WILLNEED);
+       #else
+        // no madvise here, so fault the pages in by touching one byte in each of them
+        for (auto address = first; address < last; address += pageSize)
+            ignoreUnused (*reinterpret_cast<const volatile char*> (address));
+       #endif
+    }
+
+private:
+    enum class Encoding
+    {
+        unsupported,
+        int16,
+        int24,
+        int32,
+        float32
+    };
+
+    struct Layout
+    {
+        Encoding encoding = Encoding::unsupported;
+        int numChannels = 0, numSamples = 0, bytesPerSample = 0, bytesPerFrame = 0;
+        double sampleRate = 0.0;
+        size_t dataOffset = 0;
+
+        bool isValid() const noexcept   { return encoding != Encoding::unsupported && numChannels > 0 && numSamples > 0; }
+    };
+
+    MappedWavFile (std::unique_ptr<MemoryMappedFile> mapToUse, const Layout& layoutToUse, TimeSliceThread& prefetchThread)
+        : map (std::move (mapToUse)),
+          layout (layoutToUse),
+          sampleData (static_cast<const char*> (map->getData()) + layout.dataOffset),
+          thread (prefetchThread)
+    {
+        prefetch (0, prefetchSamples);
+        thread.addTimeSliceClient (this);
+    }
+
+    int useTimeSlice() override
+    {
+        auto position = lastReadPosition.load (std::memory_order_relaxed);
+
+        prefetch (position, prefetchSamples);
+
+        // the wrap back to the loop start is coming up, so make sure that's resident too
+        if (position + prefetchSamples >= layout.numSamples)
+            prefetch (0, prefetchSamples);
+
+        return 20;
+    }
+
+    template <typename SourceFormat>
+    void convert (const char* source, float* dest, int numSamples) const noexcept
+    {
+        using SourceType = AudioData::Pointer<SourceFormat, AudioData::LittleEndian, AudioData::Interleaved, AudioData::Const>;
+        using DestType   = AudioData::Pointer<AudioData::Float32, AudioData::NativeEndian, AudioData::NonInterleaved, AudioData::NonConst>;
+
+        DestType (dest).convertSamples (SourceType (source, layout.numChannels), numSamples);
+    }
+
+    static Layout parseHeader (const char* data, size_t size)
+    {
+        Layout result;
+
+        const auto readU16 = [data] (size_t offset) { return (uint32) ByteOrder::littleEndianShort (data + offset); };
+        const auto readU32 = [data] (size_t offset) { return (uint32) ByteOrder::littleEndianInt (data + offset); };
+
+        if (size < 12 || memcmp (data, "RIFF", 4) != 0 || memcmp (data + 8, "WAVE", 4) != 0)
+            return {};
+
+        uint32 formatTag = 0, bitsPerSample = 0;
+        size_t dataSize = 0;
+        size_t offset = 12;
+
+        while (offset + 8 <= size)
+        {
+            const auto* chunkID = data + offset;
+            const auto chunkSize = (size_t) readU32 (offset + 4);
+            const auto chunkData = offset + 8;
+
+            if (chunkData + chunkSize > size && memcmp (chunkID, "data", 4) != 0)
+                return {};
+
+            if (memcmp (chunkID, "fmt ", 4) == 0 && chunkSize >= 16)
+            {
+                formatTag          = readU16 (chunkData);
+                result.numChannels = (int) readU16 (chunkData + 2);
+                result.sampleRate  = (double) readU32 (chunkData + 4);
+                bitsPerSample      = readU16 (chunkData + 14);
+
+                // WAVE_FORMAT_EXTENSIBLE keeps the real format tag at the start of the sub-format GUID
+                if (formatTag == 0xfffe && chunkSize >= 26)
+                    formatTag = readU16 (chunkData + 24);
+            }
+            else if (memcmp (chunkID, "data", 4) == 0)
+            {
+                result.dataOffset = chunkData;
+                dataSize = jmin (chunkSize, size - chunkData);
+                break;
+            }
+
+            offset = chunkData + chunkSize + (chunkSize & 1);
+        }
+
+        if (formatTag == 1)
+            result.encoding = bitsPerSample == 16 ? Encoding::int16
+                            : bitsPerSample == 24 ? Encoding::int24
+                            : bitsPerSample == 32 ? Encoding::int32
+                                                  : Encoding::unsupported;
+        else if (formatTag == 3 && bitsPerSample == 32)
+            result.encoding = Encoding::float32;
+
+        if (result.encoding == Encoding::unsupported || result.dataOffset == 0 || result.numChannels <= 0)
+            return {};
+
+        result.bytesPerSample = (int) bitsPerSample / 8;
+        result.bytesPerFrame = result.bytesPerSample * result.numChannels;
+        result.numSamples = (int) jmin ((size_t) std::numeric_limits<int>::max(), dataSize / (size_t) result.bytesPerFrame);
+
+        return result;
+    }
+
+    static constexpr int prefetchSamples = 1 << 16;
+    static constexpr uintptr_t pageSize = 4096;
+
+    std::unique_ptr<MemoryMappedFile> map;
+    const Layout layout;
+    const char* const sampleData;
+
+    TimeSliceThread& thread;
+    mutable std::atomic<int> lastReadPosition { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MappedWavFile)
+};
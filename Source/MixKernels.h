@@ -0,0 +1,274 @@
+/*
+  ==============================================================================
+
+    MixKernels.h
+    Created: 16 Oct 2026 10:45:38pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if defined (__AVX__)
+ #include <immintrin.h>
+ #define LOOPER_MIX_AVX 1
+#elif defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define LOOPER_MIX_SSE 1
+#elif defined (__ARM_NEON) || defined (__ARM_NEON__) || defined (_M_ARM64)
+ #include <arm_neon.h>
+ #define LOOPER_MIX_NEON 1
+#endif
+
+/** Vectorised inner loops for mixing loop buffers into the output.
+
+    Each kernel reads its source once and writes every destination it feeds in the same
+    pass, so fanning a mono buffer out to several output channels costs one read of the
+    source rather than one per channel.
+*/
+namespace MixKernels
+{
+    /** The most destinations a single source channel can be fanned out to in one call. */
+    static constexpr int maxDestinations = 16;
+
+    namespace detail
+    {
+        template <bool accumulate>
+        inline void processWithRamp (float* const* dests, int numDests, const float* src,
+                                     int numSamples, float startGain, float gainStep) noexcept
+        {
+            jassert (numDests <= maxDestinations);
+
+            int i = 0;
+
+           #if LOOPER_MIX_AVX
+            const auto step = _mm256_set1_ps (gainStep * 8.0f);
+            auto gain = _mm256_setr_ps (startGain,                   startGain + gainStep,
+                                        startGain + 2.0f * gainStep, startGain + 3.0f * gainStep,
+                                        startGain + 4.0f * gainStep, startGain + 5.0f * gainStep,
+                                        startGain + 6.0f * gainStep, startGain + 7.0f * gainStep);
+
+            for (; i + 8 <= numSamples; i += 8)
+            {
+                const auto scaled = _mm256_mul_ps (_mm256_loadu_ps (src + i), gain);
+
+                for (int d = 0; d < numDests; ++d)
+                    _mm256_storeu_ps (dests[d] + i, accumulate ? _mm256_add_ps (_mm256_loadu_ps (dests[d] + i), scaled) : scaled);
+
+                gain = _mm256_add_ps (gain, step);
+            }
+           #elif LOOPER_MIX_SSE
+            const auto step = _mm_set1_ps (gainStep * 4.0f);
+            auto gain = _mm_setr_ps (startGain, startGain + gainStep, startGain + 2.0f * gainStep, startGain + 3.0f * gainStep);
+
+            for (; i + 4 <= numSamples; i += 4)
+            {
+                const auto scaled = _mm_mul_ps (_mm_loadu_ps (src + i), gain);
+
+                for (int d = 0; d < numDests; ++d)
+                    _mm_storeu_ps (dests[d] + i, accumulate ? _mm_add_ps (_mm_loadu_ps (dests[d] + i), scaled) : scaled);
+
+                gain = _mm_add_ps (gain, step);
+            }
+           #elif LOOPER_MIX_NEON
+            const auto step = vdupq_n_f32 (gainStep * 4.0f);
+            const float initialGains[] = { startGain, startGain + gainStep, startGain + 2.0f * gainStep, startGain + 3.0f * gainStep };
+            auto gain = vld1q_f32 (initialGains);
+
+            for (; i + 4 <= numSamples; i += 4)
+            {
+                const auto scaled = vmulq_f32 (vld1q_f32 (src + i), gain);
+
+                for (int d = 0; d < numDests; ++d)
+                    vst1q_f32 (dests[d] + i, accumulate ? vaddq_f32 (vld1q_f32 (dests[d] + i), scaled) : scaled);
+
+                gain = vaddq_f32 (gain, step);
+            }
+           #endif
+
+            for (; i < numSamples; ++i)
+            {
+                const auto scaled = src[i] * (startGain + (float) i * gainStep);
+
+                for (int d = 0; d < numDests; ++d)
+                    dests[d][i] = accumulate ? dests[d][i] + scaled : scaled;
+            }
+        }
+
+        template <bool accumulate>
+        inline void mixWithRamp (float* const* dests, int numDests, const float* const* srcs, int numSrcs,
+                                 const float* gains, int gainStride, int numSamples, float startGain, float gainStep) noexcept
+        {
+            int i = 0;
+
+           #if LOOPER_MIX_AVX
+            const auto step = _mm256_set1_ps (gainStep * 8.0f);
+            auto ramp = _mm256_setr_ps (startGain,                   startGain + gainStep,
+                                        startGain + 2.0f * gainStep, startGain + 3.0f * gainStep,
+                                        startGain + 4.0f * gainStep, startGain + 5.0f * gainStep,
+                                        startGain + 6.0f * gainStep, startGain + 7.0f * gainStep);
+
+            for (; i + 8 <= numSamples; i += 8)
+            {
+                for (int d = 0; d < numDests; ++d)
+                {
+                    const auto* row = gains + d * gainStride;
+                    auto sum = _mm256_setzero_ps();
+
+                    for (int s = 0; s < numSrcs; ++s)
+                        if (row[s] != 0.0f)
+                            sum = _mm256_add_ps (sum, _mm256_mul_ps (_mm256_loadu_ps (srcs[s] + i), _mm256_set1_ps (row[s])));
+
+                    sum = _mm256_mul_ps (sum, ramp);
+                    _mm256_storeu_ps (dests[d] + i, accumulate ? _mm256_add_ps (_mm256_loadu_ps (dests[d] + i), sum) : sum);
+                }
+
+                ramp = _mm256_add_ps (ramp, step);
+            }
+           #elif LOOPER_MIX_SSE
+            const auto step = _mm_set1_ps (gainStep * 4.0f);
+            auto ramp = _mm_setr_ps (startGain, startGain + gainStep, startGain + 2.0f * gainStep, startGain + 3.0f * gainStep);
+
+            for (; i + 4 <= numSamples; i += 4)
+            {
+                for (int d = 0; d < numDests; ++d)
+                {
+                    const auto* row = gains + d * gainStride;
+                    auto sum = _mm_setzero_ps();
+
+                    for (int s = 0; s < numSrcs; ++s)
+                        if (row[s] != 0.0f)
+                            sum = _mm_add_ps (sum, _mm_mul_ps (_mm_loadu_ps (srcs[s] + i), _mm_set1_ps (row[s])));
+
+                    sum = _mm_mul_ps (sum, ramp);
+                    _mm_storeu_ps (dests[d] + i, accumulate ? _mm_add_ps (_mm_loadu_ps (dests[d] + i), sum) : sum);
+                }
+
+                ramp = _mm_add_ps (ramp, step);
+            }
+           #elif LOOPER_MIX_NEON
+            const auto step = vdupq_n_f32 (gainStep * 4.0f);
+            const float initialGains[] = { startGain, startGain + gainStep, startGain + 2.0f * gainStep, startGain + 3.0f * gainStep };
+            auto ramp = vld1q_f32 (initialGains);
+
+            for (; i + 4 <= numSamples; i += 4)
+            {
+                for (int d = 0; d < numDests; ++d)
+                {
+                    const auto* row = gains + d * gainStride;
+                    auto sum = vdupq_n_f32 (0.0f);
+
+                    for (int s = 0; s < numSrcs; ++s)
+                        if (row[s] != 0.0f)
+                            sum = vmlaq_n_f32 (sum, vld1q_f32 (srcs[s] + i), row[s]);
+
+                    sum = vmulq_f32 (sum, ramp);
+                    vst1q_f32 (dests[d] + i, accumulate ? vaddq_f32 (vld1q_f32 (dests[d] + i), sum) : sum);
+                }
+
+                ramp = vaddq_f32 (ramp, step);
+            }
+           #endif
+
+            for (; i < numSamples; ++i)
+            {
+                const auto gain = startGain + (float) i * gainStep;
+
+                for (int d = 0; d < numDests; ++d)
+                {
+                    const auto* row = gains + d * gainStride;
+                    auto sum = 0.0f;
+
+                    for (int s = 0; s < numSrcs; ++s)
+                        if (row[s] != 0.0f)
+                            sum += row[s] * srcs[s][i];
+
+                    dests[d][i] = accumulate ? dests[d][i] + sum * gain : sum * gain;
+                }
+            }
+        }
+    }
+
+    /** Adds src, scaled by a linear gain ramp, into each of the numDests destinations:
+
+        dests[d][i] += src[i] * (startGain + i * gainStep)
+    */
+    inline void addWithRamp (float* const* dests, int numDests, const float* src,
+                             int numSamples, float startGain, float gainStep) noexcept
+    {
+        detail::processWithRamp<true> (dests, numDests, src, numSamples, startGain, gainStep);
+    }
+
+    /** Returns the sum of a[i] * b[i]. */
+    inline float dotProduct (const float* a, const float* b, int numSamples) noexcept
+    {
+        int i = 0;
+        float sum = 0.0f;
+
+       #if LOOPER_MIX_AVX
+        auto acc = _mm256_setzero_ps();
+
+        for (; i + 8 <= numSamples; i += 8)
+            acc = _mm256_add_ps (acc, _mm256_mul_ps (_mm256_loadu_ps (a + i), _mm256_loadu_ps (b + i)));
+
+        auto acc4 = _mm_add_ps (_mm256_castps256_ps128 (acc), _mm256_extractf128_ps (acc, 1));
+        acc4 = _mm_add_ps (acc4, _mm_movehl_ps (acc4, acc4));
+        sum = _mm_cvtss_f32 (_mm_add_ss (acc4, _mm_shuffle_ps (acc4, acc4, 1)));
+       #elif LOOPER_MIX_SSE
+        auto acc = _mm_setzero_ps();
+
+        for (; i + 4 <= numSamples; i += 4)
+            acc = _mm_add_ps (acc, _mm_mul_ps (_mm_loadu_ps (a + i), _mm_loadu_ps (b + i)));
+
+        acc = _mm_add_ps (acc, _mm_movehl_ps (acc, acc));
+        sum = _mm_cvtss_f32 (_mm_add_ss (acc, _mm_shuffle_ps (acc, acc, 1)));
+       #elif LOOPER_MIX_NEON
+        auto acc = vdupq_n_f32 (0.0f);
+
+        for (; i + 4 <= numSamples; i += 4)
+            acc = vmlaq_f32 (acc, vld1q_f32 (a + i), vld1q_f32 (b + i));
+
+        const auto pair = vadd_f32 (vget_low_f32 (acc), vget_high_f32 (acc));
+        sum = vget_lane_f32 (vpadd_f32 (pair, pair), 0);
+       #endif
+
+        for (; i < numSamples; ++i)
+            sum += a[i] * b[i];
+
+        return sum;
+    }
+
+    /** Mixes several sources into several destinations through a matrix of gains, with a
+        linear gain ramp on top. Row d of gains (gainStride floats apart) holds the gain of
+        every source in destination d; sources with a gain of zero aren't read at all.
+
+        dests[d][i] = sum over s of (gains[d * gainStride + s] * srcs[s][i]) * (startGain + i * gainStep)
+
+        With accumulate set, the result is added to the destinations instead.
+    */
+    inline void mixWithRamp (float* const* dests, int numDests, const float* const* srcs, int numSrcs,
+                             const float* gains, int gainStride, int numSamples, float startGain, float gainStep,
+                             bool accumulate) noexcept
+    {
+        if (accumulate)
+            detail::mixWithRamp<true> (dests, numDests, srcs, numSrcs, gains, gainStride, numSamples, startGain, gainStep);
+        else
+            detail::mixWithRamp<false> (dests, numDests, srcs, numSrcs, gains, gainStride, numSamples, startGain, gainStep);
+    }
+
+    /** Copies src, scaled by a linear gain ramp, into each of the numDests destinations.
+
+        This does the work of one copyFrom() plus one applyGainRamp() per destination in a
+        single pass, reading the source once however many destinations it feeds:
+
+        dests[d][i] = src[i] * (startGain + i * gainStep)
+    */
+    inline void copyWithRamp (float* const* dests, int numDests, const float* src,
+                              int numSamples, float startGain, float gainStep) noexcept
+    {
+        detail::processWithRamp<false> (dests, numDests, src, numSamples, startGain, gainStep);
+    }
+}
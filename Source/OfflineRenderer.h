@@ -0,0 +1,185 @@
+/*
+  ==============================================================================
+
+    OfflineRenderer.h
+    Created: 16 Oct 2026 11:00:53pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "LoopPlayer.h"
+
+/** Bounces a looping buffer to a WAV or FLAC file as fast as the CPU allows.
+
+    The output is rendered by the same LoopPlayer the app's audio callback uses. Because a
+    loop's position depends only on how far it is from the start, the render is cut into
+    time chunks that are rendered in parallel, each by its own player starting at the
+    position the previous chunk would have reached, and then written out in order.
+
+    Chunks of a resampled render start from the exactly computed position rather than one
+    accumulated block by block, so they can differ from a single-threaded render in the
+    last bits of the interpolation phase. Renders at the file's own rate are identical.
+*/
+class OfflineRenderer
+{
+public:
+    struct Result
+    {
+        int64 numFrames = 0;
+        double wallSeconds = 0.0;
+        double speedMultiple = 0.0;     // seconds of audio rendered per second of wall time
+    };
+
+    /** Handles the --render command:
+
+        --render <input> <output.wav|output.flac> (--seconds=<n> | --loops=<n>)
+                 [--rate=<hz>] [--channels=<n>] [--bits=<16|24>] [--threads=<n>]
+                 [--quality=linear|sinc8|sinc16|sinc32]
+    */
+    static void run (const ArgumentList& args)
+    {
+        args.checkMinNumArguments (3);
+
+        const auto inputFile = args[1].resolveAsExistingFile();
+        const auto outputFile = args[2].resolveAsFile();
+
+        AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+
+        auto buffer = ReferenceCountedBuffer::createFromFile (formatManager, inputFile);
+
+        if (buffer == nullptr || buffer->getNumSamples() == 0)
+            ConsoleApplication::fail ("Couldn't read " + inputFile.getFullPathName());
+
+        const auto sampleRate = getOption (args, "--rate", buffer->getSampleRate());
+        const auto numChannels = (int) getOption (args, "--channels", buffer->getNumChannels());
+        const auto bitsPerSample = (int) getOption (args, "--bits", 24);
+        const auto numThreads = jmax (1, (int) getOption (args, "--threads", SystemStats::getNumCpus()));
+        const auto quality = PolyphaseResampler::getQualityFromName (args.getValueForOption ("--quality"), ResamplingQuality::sinc32);
+
+        const auto loopSeconds = buffer->getLoopRegion().getLength() / buffer->getSampleRate();
+        const auto seconds = args.containsOption ("--loops") ? getOption (args, "--loops", 1) * loopSeconds
+                                                              : getOption (args, "--seconds", 0);
+        const auto numFrames = (int64) std::llround (seconds * sampleRate);
+
+        if (numFrames <= 0)
+            ConsoleApplication::fail ("Give the length to render with --seconds=<n> or --loops=<n>");
+
+        auto* format = formatManager.findFormatForFileExtension (outputFile.getFileExtension());
+
+        if (format == nullptr)
+            ConsoleApplication::fail ("Don't know how to write " + outputFile.getFileName() + "; use .wav or .flac");
+
+        outputFile.deleteFile();
+        auto stream = std::make_unique<FileOutputStream> (outputFile);
+
+        if (stream->failedToOpen())
+            ConsoleApplication::fail ("Couldn't create " + outputFile.getFullPathName());
+
+        std::unique_ptr<AudioFormatWriter> writer (format->createWriterFor (stream.get(), sampleRate, (unsigned int) numChannels,
+                                                                            bitsPerSample, {}, 0));
+
+        if (writer == nullptr)
+            ConsoleApplication::fail ("The " + format->getFormatName() + " writer doesn't support "
+                                        + String (numChannels) + " channels at " + String (bitsPerSample) + " bits");
+
+        stream.release();   // the writer owns it now
+
+        const auto result = render (*buffer, *writer, numFrames, sampleRate, quality, numThreads);
+
+        std::cout << "Rendered " << String ((double) result.numFrames / sampleRate, 1) << " s of " << buffer->getName()
+                  << " to " << outputFile.getFileName() << " in " << String (result.wallSeconds, 3) << " s: "
+                  << String (result.speedMultiple, 1) << "x real time on " << numThreads << " threads" << std::endl;
+    }
+
+    /** Renders numFrames of the buffer's loop into the writer, using numThreads threads. */
+    static Result render (const ReferenceCountedBuffer& buffer, AudioFormatWriter& writer, int64 numFrames,
+                          double sampleRate, ResamplingQuality quality, int numThreads)
+    {
+        const auto numChannels = (int) writer.getNumChannels();
+        const auto numChunks = (int) ((numFrames + chunkSize - 1) / chunkSize);
+        const auto chunksPerWave = numThreads * 2;
+
+        ThreadPool pool (numThreads);
+        OwnedArray<AudioBuffer<float>> chunks;
+
+        for (int i = 0; i < chunksPerWave; ++i)
+            chunks.add (new AudioBuffer<float> (numChannels, chunkSize));
+
+        const auto startTicks = Time::getHighResolutionTicks();
+
+        // render a wave of chunks in parallel, then write them out in order
+        for (int firstChunk = 0; firstChunk < numChunks; firstChunk += chunksPerWave)
+        {
+            const auto numThisWave = jmin (chunksPerWave, numChunks - firstChunk);
+            std::atomic<int> numRemaining { numThisWave };
+            WaitableEvent waveFinished;
+
+            for (int i = 0; i < numThisWave; ++i)
+            {
+                pool.addJob ([&, i]
+                {
+                    const auto startFrame = (int64) (firstChunk + i) * chunkSize;
+                    renderChunk (buffer, *chunks[i], startFrame, (int) jmin ((int64) chunkSize, numFrames - startFrame),
+                                 sampleRate, quality);
+
+                    if (--numRemaining == 0)
+                        waveFinished.signal();
+                });
+            }
+
+            waveFinished.wait();
+
+            for (int i = 0; i < numThisWave; ++i)
+            {
+                const auto startFrame = (int64) (firstChunk + i) * chunkSize;
+
+                if (! writer.writeFromAudioSampleBuffer (*chunks[i], 0, (int) jmin ((int64) chunkSize, numFrames - startFrame)))
+                    ConsoleApplication::fail ("Couldn't write to the output file");
+            }
+        }
+
+        writer.flush();
+
+        Result result;
+        result.numFrames = numFrames;
+        result.wallSeconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+        result.speedMultiple = ((double) numFrames / sampleRate) / jmax (1.0e-9, result.wallSeconds);
+        return result;
+    }
+
+private:
+    static constexpr int chunkSize = 1 << 16;
+    static constexpr int blockSize = ReferenceCountedBuffer::maxContiguousRead;
+
+    static void renderChunk (const ReferenceCountedBuffer& buffer, AudioBuffer<float>& output, int64 startFrame, int numFrames,
+                             double sampleRate, ResamplingQuality quality)
+    {
+        const auto loopRegion = buffer.getLoopRegion();
+        const auto speedRatio = buffer.getSampleRate() / sampleRate;
+
+        LoopPlayer player;
+        player.prepareToPlay (blockSize, sampleRate);
+        player.setResamplingQuality (quality);
+
+        // where a single player would be after startFrame frames; exact when no resampling is needed
+        if (approximatelyEqual (speedRatio, 1.0))
+            player.setPosition ((double) (loopRegion.getStart() + startFrame % loopRegion.getLength()));
+        else
+            player.setPosition (loopRegion.getStart() + std::fmod ((double) startFrame * speedRatio, (double) loopRegion.getLength()));
+
+        for (int offset = 0; offset < numFrames; offset += blockSize)
+            player.renderNextBlock (buffer, AudioSourceChannelInfo (&output, offset, jmin (blockSize, numFrames - offset)));
+    }
+
+    static double getOption (const ArgumentList& args, StringRef option, double defaultValue)
+    {
+        const auto value = args.getValueForOption (option);
+        return value.isEmpty() ? defaultValue : value.getDoubleValue();
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (OfflineRenderer)
+};
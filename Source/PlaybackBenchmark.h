@@ -0,0 +1,442 @@
+/*
+  ==============================================================================
+
+    PlaybackBenchmark.h
+    Created: 16 Oct 2026 10:59:43pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "LoopPlayer.h"
+#include "MixKernels.h"
+#include "RealtimeChecker.h"
+#include "LooperVoiceEngine.h"
+
+/** Times the playback hot path without an audio device and reports the results as JSON.
+
+    Every case renders blocks through the same LoopPlayer (or LooperVoiceEngine) the app's
+    audio callback uses, sweeping block size, channel layout, buffer length (and with it
+    how often the loop wraps), storage format and resampling quality, and for the voice
+    engine the number of voices and of threads rendering them. Each result names the kind of
+    ChannelRouting its layout gets, so the identity, fan-out and downmix kernels can be
+    compared, and the fused gain-ramp copy is timed against the copyFrom() plus
+    applyGainRamp() it replaces. The fixtures are the
+    two files in Resources: cello.wav (mono, 22.05 kHz) and sine441Hz-1s.wav (stereo,
+    44.1 kHz).
+
+    Each case is run several times for at least a minimum duration and the median is
+    reported, so a noisy neighbour on the machine doesn't skew a single figure.
+*/
+class PlaybackBenchmark
+{
+public:
+    /** Runs the sweep. Options: --fixtures=<folder>, --output=<file.json>, --quick. */
+    static void run (const ArgumentList& args)
+    {
+        const auto quick = args.containsOption ("--quick");
+        const auto fixtures = findFixturesFolder (args);
+
+        AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+
+        PlaybackBenchmark benchmark (quick ? 0.005 : 0.02);
+
+        for (auto name : { "cello.wav", "sine441Hz-1s.wav" })
+        {
+            auto fixture = ReferenceCountedBuffer::createFromFile (formatManager, fixtures.getChildFile (name));
+
+            if (fixture == nullptr)
+                ConsoleApplication::fail ("Couldn't read " + fixtures.getChildFile (name).getFullPathName());
+
+            benchmark.runLoopPlayerCases (name, *fixture, quick);
+            benchmark.runVoiceEngineCases (name, *fixture, quick);
+            benchmark.runRampKernelCases (name, *fixture, quick);
+        }
+
+        auto* root = new DynamicObject();
+        root->setProperty ("cpu", SystemStats::getCpuModel());
+        root->setProperty ("numCpus", SystemStats::getNumCpus());
+        root->setProperty ("simd", getSimdName());
+        root->setProperty ("results", benchmark.results);
+
+        const auto json = JSON::toString (var (root));
+        const auto outputFile = args.getValueForOption ("--output");
+
+        if (outputFile.isEmpty())
+            std::cout << json << std::endl;
+        else if (! File::getCurrentWorkingDirectory().getChildFile (outputFile).replaceWithText (json))
+            ConsoleApplication::fail ("Couldn't write " + outputFile);
+
+        // in a build with LOOPER_REALTIME_CHECKS, the blocks are rendered as if on the audio thread
+        if (const auto numViolations = RealtimeChecker::getNumViolations())
+            ConsoleApplication::fail (String ((int64) numViolations) + " real-time violations in the playback path");
+    }
+
+    //==============================================================================
+    /** Finds the folder holding the fixtures: --fixtures=<folder>, or a Resources folder
+        next to, or somewhere above, the executable or the working directory.
+    */
+    static File findFixturesFolder (const ArgumentList& args)
+    {
+        const auto specified = args.getValueForOption ("--fixtures");
+
+        if (specified.isNotEmpty())
+            return File::getCurrentWorkingDirectory().getChildFile (specified);
+
+        for (auto start : { File::getCurrentWorkingDirectory(),
+                            File::getSpecialLocation (File::currentExecutableFile).getParentDirectory() })
+        {
+            for (auto folder = start; ; folder = folder.getParentDirectory())
+            {
+                const auto resources = folder.getChildFile ("Resources");
+
+                if (resources.getChildFile ("cello.wav").existsAsFile())
+                    return resources;
+
+                if (folder.isRoot())
+                    break;
+            }
+        }
+
+        ConsoleApplication::fail ("Couldn't find the Resources folder; pass it with --fixtures=<folder>");
+        return {};
+    }
+
+    static constexpr double deviceSampleRate = 44100.0;
+
+private:
+    explicit PlaybackBenchmark (double minSecondsPerRun)
+        : minSeconds (minSecondsPerRun)
+    {
+    }
+
+    //==============================================================================
+    struct Case
+    {
+        String fixture, engine = "loopPlayer";
+        int bufferLength = 0, numInputChannels = 1, numOutputChannels = 2, blockSize = 512, numVoices = 0, numThreads = 1;
+        double sampleRate = deviceSampleRate;
+        SampleFormat format = SampleFormat::float32;
+        bool resampled = false;
+        ResamplingQuality quality = ResamplingQuality::sinc16;
+    };
+
+    void runLoopPlayerCases (const String& fixtureName, const ReferenceCountedBuffer& fixture, bool quick)
+    {
+        const int layouts[][2] = { { 1, 1 }, { 1, 2 }, { 2, 2 }, { 1, 8 }, { 2, 8 }, { 2, 16 }, { 6, 2 }, { 8, 6 } };
+        const int shortLengths[] = { 4096, 512, 64, 7 };
+
+        Case c;
+        c.fixture = fixtureName;
+
+        // block size x channel layout x buffer length, the last ones shorter than most blocks
+        for (int blockSize = 16; blockSize <= 4096; blockSize *= (quick ? 4 : 2))
+        {
+            c.blockSize = blockSize;
+
+            for (auto& layout : layouts)
+            {
+                c.numInputChannels = layout[0];
+                c.numOutputChannels = layout[1];
+
+                c.bufferLength = fixture.getNumSamples();
+                runLoopPlayerCase (c, fixture);
+
+                for (auto length : shortLengths)
+                {
+                    c.bufferLength = length;
+                    runLoopPlayerCase (c, fixture);
+                }
+            }
+        }
+
+        // storage formats, at whole-file length
+        c.bufferLength = fixture.getNumSamples();
+        c.numInputChannels = fixture.getNumChannels();
+        c.numOutputChannels = 2;
+
+        for (auto format : { SampleFormat::float32, SampleFormat::int16, SampleFormat::float16 })
+        {
+            for (auto blockSize : { 64, 512, 4096 })
+            {
+                c.format = format;
+                c.blockSize = blockSize;
+                runLoopPlayerCase (c, fixture);
+            }
+        }
+
+        // real-time resampling from the file's own rate to one that neither fixture uses
+        c.format = SampleFormat::float32;
+        c.resampled = true;
+        c.sampleRate = 48000.0;
+
+        for (auto quality : { ResamplingQuality::linear, ResamplingQuality::sinc8, ResamplingQuality::sinc16, ResamplingQuality::sinc32 })
+        {
+            for (auto blockSize : { 64, 512 })
+            {
+                c.quality = quality;
+                c.blockSize = blockSize;
+                runLoopPlayerCase (c, fixture);
+            }
+        }
+    }
+
+    void runLoopPlayerCase (const Case& c, const ReferenceCountedBuffer& fixture)
+    {
+        auto buffer = makeBuffer (fixture, c);
+
+        LoopPlayer player;
+        player.prepareToPlay (c.blockSize, c.sampleRate);
+        player.setResamplingQuality (c.quality);
+
+        AudioBuffer<float> output (c.numOutputChannels, c.blockSize);
+        const AudioSourceChannelInfo info (&output, 0, c.blockSize);
+        int64 loopWraps = 0;
+
+        const auto result = measure (c.blockSize, [&] { loopWraps += player.renderNextBlock (*buffer, info); });
+        addResult (c, result, (double) loopWraps / (double) result.numBlocks, buffer->getSizeInBytes());
+    }
+
+    void runVoiceEngineCases (const String& fixtureName, const ReferenceCountedBuffer& fixture, bool quick)
+    {
+        Case c;
+        c.fixture = fixtureName;
+        c.engine = "voiceEngine";
+        c.bufferLength = fixture.getNumSamples();
+        c.numInputChannels = fixture.getNumChannels();
+
+        for (auto numVoices : { 1, 16, 64, 256 })
+        {
+            for (auto blockSize : { 64, 512 })
+            {
+                c.numVoices = numVoices;
+                c.blockSize = blockSize;
+                runVoiceEngineCase (c, fixture);
+
+                if (quick)
+                    break;
+            }
+        }
+
+        // how the heaviest case scales as more threads share it, up to one per core; the
+        // single-threaded figure for it is the last one above
+        const auto numCpus = SystemStats::getNumCpus();
+
+        for (int numThreads = 2; numThreads <= numCpus; ++numThreads)
+        {
+            if (quick && numThreads < numCpus)
+                continue;
+
+            c.numThreads = numThreads;
+            runVoiceEngineCase (c, fixture);
+        }
+    }
+
+    void runVoiceEngineCase (const Case& c, const ReferenceCountedBuffer& fixture)
+    {
+        auto buffer = makeBuffer (fixture, c);
+
+        AudioThreadEpoch epoch;
+        ReleasePool releasePool (epoch);
+        LooperVoiceEngine engine (releasePool, c.numVoices);
+        engine.setNumWorkerThreads (c.numThreads - 1);
+        engine.prepareToPlay (c.blockSize, c.sampleRate, c.numOutputChannels);
+
+        Random random (1);
+
+        for (int i = 0; i < c.numVoices; ++i)
+            engine.startVoice (buffer, 1.0f / (float) c.numVoices, {}, random.nextInt (buffer->getNumSamples()));
+
+        AudioBuffer<float> output (c.numOutputChannels, c.blockSize);
+
+        const auto result = measure (c.blockSize, [&]
+        {
+            const AudioThreadEpoch::ScopedCallback callback { epoch };
+            output.clear();
+            engine.renderNextBlock (output, 0, c.blockSize);
+        });
+
+        addResult (c, result, 0.0, buffer->getSizeInBytes());
+        engine.stopAllVoices();
+    }
+
+    /** Times MixKernels::copyWithRamp() against the copyFrom() and applyGainRamp() per
+        destination that it does the work of, for one source feeding one or more outputs.
+    */
+    void runRampKernelCases (const String& fixtureName, const ReferenceCountedBuffer& fixture, bool quick)
+    {
+        Case c;
+        c.fixture = fixtureName;
+
+        for (auto numDests : { 1, 2, 8 })
+        {
+            for (auto blockSize : { 64, 512, 4096 })
+            {
+                if (quick && blockSize == 4096)
+                    continue;
+
+                c.numOutputChannels = numDests;
+                c.blockSize = c.bufferLength = blockSize;
+
+                AudioBuffer<float> source (1, blockSize);
+                source.clear();
+                fixture.read (0, 0, source.getWritePointer (0), jmin (blockSize, fixture.getNumSamples()));
+
+                AudioBuffer<float> output (numDests, blockSize);
+                const auto* src = source.getReadPointer (0);
+                const auto gainStep = 1.0f / (float) blockSize;
+
+                c.engine = "copyFrom+applyGainRamp";
+                addResult (c, measure (blockSize, [&]
+                {
+                    for (int channel = 0; channel < numDests; ++channel)
+                    {
+                        output.copyFrom (channel, 0, src, blockSize);
+                        output.applyGainRamp (channel, 0, blockSize, 0.0f, 1.0f);
+                    }
+                }), 0.0, 0);
+
+                c.engine = "copyWithRamp";
+                addResult (c, measure (blockSize, [&]
+                {
+                    MixKernels::copyWithRamp (output.getArrayOfWritePointers(), numDests, src, blockSize, 0.0f, gainStep);
+                }), 0.0, 0);
+            }
+        }
+    }
+
+    //==============================================================================
+    /** A buffer of the requested length and channel count, built from the start of the fixture. */
+    static ReferenceCountedBuffer::Ptr makeBuffer (const ReferenceCountedBuffer& fixture, const Case& c)
+    {
+        ReferenceCountedBuffer::Ptr buffer = new ReferenceCountedBuffer (fixture.getName(), c.numInputChannels, c.bufferLength);
+
+        for (int channel = 0; channel < c.numInputChannels; ++channel)
+            for (int start = 0; start < c.bufferLength; start += fixture.getNumSamples())
+                fixture.read (channel % fixture.getNumChannels(), 0, buffer->getDataRef().getWritePointer (channel, start),
+                              jmin (fixture.getNumSamples(), c.bufferLength - start));
+
+        // unless the case is about resampling, play at the device rate so the direct path is timed
+        buffer->setSampleRate (c.resampled ? fixture.getSampleRate() : c.sampleRate);
+        buffer->setLoopRegion ({ 0, c.bufferLength });
+
+        if (c.format != SampleFormat::float32)
+            buffer = ReferenceCountedBuffer::createCopy (fixture.getName(), *buffer, c.format);
+
+        return buffer;
+    }
+
+    struct Measurement
+    {
+        double secondsPerBlock = 0.0;
+        int64 numBlocks = 0;
+    };
+
+    /** Runs renderBlock repeatedly and returns the median time per block over several runs. */
+    template <typename RenderFunction>
+    Measurement measure (int blockSize, RenderFunction&& render)
+    {
+        auto renderBlock = [&]
+        {
+            RealtimeChecker::ScopedAudioThread realtimeCheck;
+            render();
+        };
+
+        constexpr int numRuns = 5;
+
+        // warm the caches and let the branch predictors settle
+        for (int i = 0; i < jmax (4, 16384 / blockSize); ++i)
+            renderBlock();
+
+        Array<double> runTimes;
+        int64 numBlocks = 0;
+
+        for (int run = 0; run < numRuns; ++run)
+        {
+            int64 blocksThisRun = 0;
+            const auto start = Time::getHighResolutionTicks();
+            double elapsed = 0.0;
+
+            do
+            {
+                for (int i = 0; i < 8; ++i)
+                    renderBlock();
+
+                blocksThisRun += 8;
+                elapsed = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+            }
+            while (elapsed < minSeconds);
+
+            runTimes.add (elapsed / (double) blocksThisRun);
+            numBlocks += blocksThisRun;
+        }
+
+        runTimes.sort();
+        return { runTimes[numRuns / 2], numBlocks };
+    }
+
+    void addResult (const Case& c, const Measurement& m, double loopWrapsPerBlock, size_t bufferBytes)
+    {
+        const auto secondsPerFrame = m.secondsPerBlock / c.blockSize;
+        const auto secondsPerSample = secondsPerFrame / c.numOutputChannels;
+
+        auto* result = new DynamicObject();
+        result->setProperty ("fixture", c.fixture);
+        result->setProperty ("engine", c.engine);
+        result->setProperty ("blockSize", c.blockSize);
+        result->setProperty ("inputChannels", c.numInputChannels);
+        result->setProperty ("outputChannels", c.numOutputChannels);
+        result->setProperty ("routing", getRoutingName (ChannelRouting::createDefault (c.numInputChannels, c.numOutputChannels).getKind()));
+        result->setProperty ("bufferLength", c.bufferLength);
+        result->setProperty ("format", getFormatName (c.format));
+        result->setProperty ("resampling", c.resampled ? PolyphaseResampler::getQualityName (c.quality) : String ("none"));
+
+        if (c.numVoices > 0)
+        {
+            result->setProperty ("voices", c.numVoices);
+            result->setProperty ("threads", c.numThreads);
+        }
+
+        result->setProperty ("loopWrapsPerBlock", loopWrapsPerBlock);
+        result->setProperty ("bufferBytes", (int64) bufferBytes);
+        result->setProperty ("nsPerSample", secondsPerSample * 1.0e9);
+        result->setProperty ("nsPerFrame", secondsPerFrame * 1.0e9);
+        result->setProperty ("megasamplesPerSecond", 1.0e-6 / secondsPerSample);
+        result->setProperty ("outputMegabytesPerSecond", sizeof (float) * 1.0e-6 / secondsPerSample);
+        result->setProperty ("sampleRate", c.sampleRate);
+        result->setProperty ("realtimeMultiple", 1.0 / (secondsPerFrame * c.sampleRate));
+
+        results.add (var (result));
+    }
+
+    static String getFormatName (SampleFormat format)
+    {
+        return format == SampleFormat::int16 ? "int16" : (format == SampleFormat::float16 ? "float16" : "float32");
+    }
+
+    static String getRoutingName (ChannelRouting::Kind kind)
+    {
+        return kind == ChannelRouting::Kind::identity ? "identity" : (kind == ChannelRouting::Kind::fanOut ? "fanOut" : "matrix");
+    }
+
+    static String getSimdName()
+    {
+       #if LOOPER_MIX_AVX
+        return "avx";
+       #elif LOOPER_MIX_SSE
+        return "sse2";
+       #elif LOOPER_MIX_NEON
+        return "neon";
+       #else
+        return "scalar";
+       #endif
+    }
+
+    const double minSeconds;
+    Array<var> results;
+
+    JUCE_DECLARE_NON_COPYABLE (PlaybackBenchmark)
+};
@@ -0,0 +1,362 @@
+/*
+  ==============================================================================
+
+    PolyphaseResampler.h
+    Created: 16 Oct 2026 10:48:27pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ReferenceCountedBuffer.h"
+#include "MixKernels.h"
+
+/** The interpolation used when a buffer plays at a rate other than the device's. */
+enum class ResamplingQuality
+{
+    linear,     // 2 taps, cheapest, audible aliasing and high-frequency droop
+    sinc8,      // 8-tap windowed sinc
+    sinc16,     // 16-tap windowed sinc
+    sinc32      // 32-tap windowed sinc, for offline conversion or when CPU is plentiful
+};
+
+//==============================================================================
+/** Reads a looped region of a buffer at an arbitrary speed.
+
+    The windowed-sinc qualities use a polyphase table of Blackman-windowed sinc kernels,
+    interpolated linearly between neighbouring phases; each output sample is two
+    vectorised dot products. The span of source needed for a block is first copied into
+    scratch memory with the loop unwrapped, so the kernel never has to deal with the wrap
+    point (or with buffers whose samples have to be converted on read).
+
+    Reading faster than the output rate moves source frequencies above the output's Nyquist
+    frequency, so the kernels' cutoff has to come down with the speed. prepare() builds a
+    band of tables for each quarter-octave of speed up to the fastest expected, each cut off
+    for the fastest speed in its band, and process() uses the band its speed falls in.
+
+    prepare() allocates; process() doesn't, so it can run on the audio thread. The read
+    position is owned by the caller, which lets many voices share one resampler.
+*/
+class PolyphaseResampler
+{
+public:
+    PolyphaseResampler() = default;
+
+    /** Builds the kernel tables and scratch space.
+
+        @param maxOutputSamples     the largest block process() will usually be asked for
+        @param maxSpeedRatio        the highest source/output rate ratio expected; faster
+                                    speeds still work, but are processed in smaller pieces
+                                    and with the tables for maxSpeedRatio, so they can alias
+    */
+    void prepare (int maxOutputSamples, double maxSpeedRatio)
+    {
+        prepareScratch (maxOutputSamples, maxSpeedRatio);
+        bands.clear();
+        addBand (1.0);
+
+        for (auto limit = bandStep; bands.back().maxSpeedRatio < maxSpeedRatio; limit *= bandStep)
+            addBand (jmin (limit, maxSpeedRatio));
+    }
+
+    /** Like prepare(), for a speed that never changes: only the tables for that speed are built. */
+    void prepareForFixedSpeed (int maxOutputSamples, double speedRatio)
+    {
+        prepareScratch (maxOutputSamples, speedRatio);
+        bands.clear();
+        addBand (jmax (1.0, speedRatio));
+    }
+
+    static int getNumTaps (ResamplingQuality quality) noexcept
+    {
+        switch (quality)
+        {
+            case ResamplingQuality::sinc8:  return 8;
+            case ResamplingQuality::sinc16: return 16;
+            case ResamplingQuality::sinc32: return 32;
+            case ResamplingQuality::linear:
+            default:                        return 2;
+        }
+    }
+
+    static String getQualityName (ResamplingQuality quality)
+    {
+        switch (quality)
+        {
+            case ResamplingQuality::linear: return "linear";
+            case ResamplingQuality::sinc8:  return "sinc8";
+            case ResamplingQuality::sinc32: return "sinc32";
+            case ResamplingQuality::sinc16:
+            default:                        return "sinc16";
+        }
+    }
+
+    /** The inverse of getQualityName(), or fallback if the name isn't recognised. */
+    static ResamplingQuality getQualityFromName (const String& name, ResamplingQuality fallback)
+    {
+        for (auto quality : { ResamplingQuality::linear, ResamplingQuality::sinc8, ResamplingQuality::sinc16, ResamplingQuality::sinc32 })
+            if (name.equalsIgnoreCase (getQualityName (quality)))
+                return quality;
+
+        return fallback;
+    }
+
+    /** Renders numOutputSamples from every channel of the source into dests, advancing
+        position (in source samples) by speedRatio per output sample and wrapping it within
+        loopRegion.
+    */
+    void process (const ReferenceCountedBuffer& source, Range<int> loopRegion, double& position, double speedRatio,
+                  ResamplingQuality quality, float* const* dests, int numOutputSamples) noexcept
+    {
+        const auto numChannels = jmin (source.getNumChannels(), maxChannels);
+        const auto numTaps = getNumTaps (quality);
+        const auto maxChunk = jmax (1, (int) ((scratch.getNumSamples() - numTaps - 2) / speedRatio));
+
+        jassert (! loopRegion.isEmpty() && speedRatio > 0.0);
+
+        for (int done = 0; done < numOutputSamples;)
+        {
+            const auto numThisTime = jmin (numOutputSamples - done, maxChunk);
+
+            // the span of source samples this chunk touches, with the loop unwrapped
+            const auto firstIndex = (int) std::floor (position) - (numTaps / 2 - 1);
+            const auto numNeeded = (int) std::floor (position + (numThisTime - 1) * speedRatio) + numTaps / 2 - firstIndex + 2;
+
+            const float* sources[maxChannels];
+            float* chunkDests[maxChannels];
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                readLooped (source, loopRegion, channel, firstIndex, numNeeded, scratch.getWritePointer (channel));
+                sources[channel] = scratch.getReadPointer (channel);
+                chunkDests[channel] = dests[channel] + done;
+            }
+
+            auto localPosition = position - firstIndex;
+            processSpan (sources, numChannels, localPosition, speedRatio, quality, chunkDests, numThisTime);
+
+            position = wrap (position + numThisTime * speedRatio, loopRegion);
+            done += numThisTime;
+        }
+    }
+
+    /** Renders numOutputSamples from arrays of source samples that don't loop, such as a
+        stream's, advancing position (an index into the arrays) by speedRatio per output
+        sample. The arrays must hold every sample from floor (position) - (getNumTaps() / 2 - 1)
+        up to floor (the last position) + getNumTaps() / 2.
+    */
+    void processSpan (const float* const* sources, int numChannels, double& position, double speedRatio,
+                      ResamplingQuality quality, float* const* dests, int numOutputSamples) const noexcept
+    {
+        const auto numTaps = getNumTaps (quality);
+        const auto* table = getTable (quality, speedRatio);
+
+        jassert (numChannels <= maxChannels && position >= numTaps / 2 - 1);
+
+        for (int i = 0; i < numOutputSamples; ++i)
+        {
+            const auto local = position + i * speedRatio - (numTaps / 2 - 1);
+            const auto index = (int) local;
+            const auto fraction = (float) (local - index);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                dests[channel][i] = interpolate (table, numTaps, sources[channel] + index, fraction);
+        }
+
+        position += numOutputSamples * speedRatio;
+    }
+
+    /** Converts a whole buffer to a new sample rate, treating it as a loop so the end
+        joins up with the start. Not for the audio thread.
+    */
+    static ReferenceCountedBuffer::Ptr convertSampleRate (const String& name, const ReferenceCountedBuffer& source,
+                                                          double targetSampleRate, ResamplingQuality quality)
+    {
+        const auto newLength = jmax (1, roundToInt (source.getNumSamples() * targetSampleRate / source.getSampleRate()));
+
+        // chosen so that the converted loop is exactly as long as the original one
+        const auto speedRatio = (double) source.getNumSamples() / newLength;
+        const auto blockSize = 4096;
+
+        PolyphaseResampler resampler;
+        resampler.prepareForFixedSpeed (blockSize, speedRatio);
+
+        ReferenceCountedBuffer::Ptr result = new ReferenceCountedBuffer (name, source.getNumChannels(), newLength);
+        result->setSampleRate (targetSampleRate);
+
+        auto& dest = result->getDataRef();
+        double position = 0.0;
+
+        for (int start = 0; start < newLength; start += blockSize)
+        {
+            float* dests[maxChannels] = {};
+
+            for (int channel = 0; channel < jmin (dest.getNumChannels(), maxChannels); ++channel)
+                dests[channel] = dest.getWritePointer (channel, start);
+
+            resampler.process (source, { 0, source.getNumSamples() }, position, speedRatio,
+                               quality, dests, jmin (blockSize, newLength - start));
+        }
+
+        result->setLoopRegion ({ 0, newLength });
+
+        return result;
+    }
+
+    static constexpr int maxChannels = 16;
+
+private:
+    static constexpr int numPhases = 256;
+    static constexpr int maxTaps = 32;
+    static constexpr double passband = 0.95;                // of the output's Nyquist frequency
+    static constexpr double bandStep = 1.189207115002721;   // a quarter of an octave
+
+    /** The kernel tables for the speeds above the previous band's maxSpeedRatio up to this one's. */
+    struct Band
+    {
+        double maxSpeedRatio = 1.0;
+        HeapBlock<float> tables[4];
+    };
+
+    void prepareScratch (int maxOutputSamples, double maxSpeedRatio)
+    {
+        scratch.setSize (maxChannels, (int) std::ceil (maxOutputSamples * jmax (1.0, maxSpeedRatio)) + maxTaps + 2);
+    }
+
+    void addBand (double maxSpeedRatio)
+    {
+        Band band;
+        band.maxSpeedRatio = maxSpeedRatio;
+
+        for (auto quality : { ResamplingQuality::sinc8, ResamplingQuality::sinc16, ResamplingQuality::sinc32 })
+            buildTable (band.tables[(size_t) quality], getNumTaps (quality), passband / jmax (1.0, maxSpeedRatio));
+
+        bands.push_back (std::move (band));
+    }
+
+    /** The table for the band a speed falls in, or nullptr for linear interpolation. */
+    const float* getTable (ResamplingQuality quality, double speedRatio) const noexcept
+    {
+        if (quality == ResamplingQuality::linear || bands.empty())
+            return nullptr;
+
+        for (auto& band : bands)
+            if (speedRatio <= band.maxSpeedRatio)
+                return band.tables[(size_t) quality].getData();
+
+        return bands.back().tables[(size_t) quality].getData();
+    }
+
+    static float interpolate (const float* table, int numTaps, const float* taps, float fraction) noexcept
+    {
+        if (table == nullptr)
+            return taps[0] + fraction * (taps[1] - taps[0]);
+
+        const auto phase = fraction * (float) numPhases;
+        const auto phaseIndex = jmin ((int) phase, numPhases - 1);
+        const auto phaseFraction = phase - (float) phaseIndex;
+
+        const auto* row = table + phaseIndex * numTaps;
+        const auto a = MixKernels::dotProduct (row, taps, numTaps);
+        const auto b = MixKernels::dotProduct (row + numTaps, taps, numTaps);
+
+        return a + phaseFraction * (b - a);
+    }
+
+    static double wrap (double position, Range<int> loopRegion) noexcept
+    {
+        const auto length = (double) loopRegion.getLength();
+        auto offset = std::fmod (position - loopRegion.getStart(), length);
+
+        if (offset < 0.0)
+            offset += length;
+
+        // fmod of a tiny negative number can round up to exactly one loop length
+        return offset < length ? loopRegion.getStart() + offset : (double) loopRegion.getStart();
+    }
+
+    static void readLooped (const ReferenceCountedBuffer& source, Range<int> loopRegion,
+                            int channel, int startIndex, int numSamples, float* dest) noexcept
+    {
+        // while the buffer is still being decoded, taps left of the loop start would wrap to a loop
+        // end that isn't there yet (and may hold a reused block's old samples), so they're silent
+        if (startIndex < loopRegion.getStart() && source.getNumValidSamples() < loopRegion.getEnd())
+        {
+            const auto numSilent = jmin (numSamples, loopRegion.getStart() - startIndex);
+            FloatVectorOperations::clear (dest, numSilent);
+
+            dest += numSilent;
+            numSamples -= numSilent;
+            startIndex = loopRegion.getStart();
+        }
+
+        auto index = (int) wrap (startIndex, loopRegion);
+
+        // the buffer's own loop can be read through its guard, which includes any crossfade
+        if (loopRegion == source.getLoopRegion())
+        {
+            for (; numSamples > 0; dest += ReferenceCountedBuffer::maxContiguousRead, numSamples -= ReferenceCountedBuffer::maxContiguousRead)
+            {
+                const auto numThisTime = jmin (numSamples, ReferenceCountedBuffer::maxContiguousRead);
+                source.readLoop (channel, index, dest, numThisTime);
+                index = source.advanceLoopPosition (index, numThisTime);
+            }
+
+            return;
+        }
+
+        while (numSamples > 0)
+        {
+            const auto numThisTime = jmin (numSamples, loopRegion.getEnd() - index);
+            source.read (channel, index, dest, numThisTime);
+
+            dest += numThisTime;
+            numSamples -= numThisTime;
+            index += numThisTime;
+
+            if (index >= loopRegion.getEnd())
+                index = loopRegion.getStart();
+        }
+    }
+
+    static void buildTable (HeapBlock<float>& table, int numTaps, double cutoff)
+    {
+        const auto halfWidth = numTaps / 2;
+
+        // one extra row, so phase numPhases - 1 can interpolate towards the next sample's phase 0
+        table.allocate ((size_t) ((numPhases + 1) * numTaps), true);
+
+        for (int phase = 0; phase <= numPhases; ++phase)
+        {
+            auto* row = table.getData() + phase * numTaps;
+            const auto fraction = (double) phase / numPhases;
+            auto sum = 0.0;
+
+            for (int tap = 0; tap < numTaps; ++tap)
+            {
+                const auto distance = (tap - (halfWidth - 1)) - fraction;
+                const auto x = distance / halfWidth;
+                const auto window = std::abs (x) >= 1.0 ? 0.0
+                                                        : 0.42 + 0.5 * std::cos (MathConstants<double>::pi * x)
+                                                               + 0.08 * std::cos (MathConstants<double>::twoPi * x);
+                const auto arg = MathConstants<double>::pi * cutoff * distance;
+                const auto sinc = std::abs (arg) < 1.0e-9 ? 1.0 : std::sin (arg) / arg;
+
+                row[tap] = (float) (window * sinc);
+                sum += row[tap];
+            }
+
+            // unity gain at DC for every phase
+            if (sum != 0.0)
+                for (int tap = 0; tap < numTaps; ++tap)
+                    row[tap] = (float) (row[tap] / sum);
+        }
+    }
+
+    AudioBuffer<float> scratch;
+    std::vector<Band> bands;    // in order of speed, the first for speeds up to 1
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PolyphaseResampler)
+};
@@ -0,0 +1,216 @@
+/*
+  ==============================================================================
+
+    ProgressiveLoader.h
+    Created: 16 Oct 2026 10:51:08pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ReferenceCountedBuffer.h"
+#include "TraceRecorder.h"
+
+/** Decodes a file in chunks so that it can start playing before it has been read completely.
+
+    load() decodes the first chunk on the calling thread and returns the buffer straight
+    away; the rest is decoded on a ThreadPool. Formats that can seek cheaply are decoded
+    by several jobs in parallel, each with its own reader (or with the first one, for a job
+    that can't open the file again); the others are decoded in order by a single job. As chunks complete, the buffer's valid-sample watermark is moved up
+    to the end of the contiguous run of finished chunks from the start of the file, and
+    the audio thread never reads past it.
+
+    A decode can be cancelled between chunks through its Hooks, e.g. once the file it's
+    reading has been superseded by another one; its buffer then never becomes fully loaded.
+*/
+class ProgressiveLoader
+{
+public:
+    /** Optional callbacks for a decode. Both may be called from any of the decoding threads. */
+    struct Hooks
+    {
+        std::function<bool()> shouldCancel;                                 // polled before each chunk
+        std::function<void (ReferenceCountedBuffer::Ptr)> onFullyLoaded;    // once the last chunk is in
+    };
+
+    static ReferenceCountedBuffer::Ptr load (const String& name, std::unique_ptr<AudioFormatReader> reader, const File& file,
+                                             AudioFormatManager& formatManager, ThreadPool& pool,
+                                             SampleFormat format = SampleFormat::float32, int chunkSize = 1 << 16,
+                                             Hooks hooks = {})
+    {
+        jassert (reader != nullptr && chunkSize > 0);
+
+        Decode::Ptr decode = new Decode (createBuffer (name, *reader, format), file, chunkSize, std::move (hooks));
+        const auto& buffer = decode->buffer;
+
+        if (decode->shouldStop())
+            return buffer;
+
+        decode->decodeChunk (*reader, 0);
+
+        if (decode->numChunks > 1)
+        {
+            const auto seekCheaply = canSeekCheaply (*reader);
+            std::shared_ptr<AudioFormatReader> firstReader (reader.release());
+
+            if (seekCheaply)
+            {
+                for (int i = 0; i < jmin (pool.getNumThreads(), decode->numChunks - 1); ++i)
+                    pool.addJob ([decode, firstReader, &formatManager]
+                    {
+                        std::unique_ptr<AudioFormatReader> jobReader (formatManager.createReaderFor (decode->file));
+
+                        if (jobReader != nullptr)
+                        {
+                            decode->decodeRemainingChunks (*jobReader);
+                            return;
+                        }
+
+                        // the file couldn't be opened again, e.g. it's been moved or locked since, so this
+                        // job decodes with the first reader instead, unless another job already is: that
+                        // one carries on until every chunk has been claimed, so nothing is left undecoded
+                        const ScopedTryLock stl (decode->firstReaderLock);
+
+                        if (stl.isLocked())
+                            decode->decodeRemainingChunks (*firstReader);
+                    });
+            }
+            else
+            {
+                pool.addJob ([decode, firstReader]
+                {
+                    decode->decodeRemainingChunks (*firstReader);
+                });
+            }
+        }
+
+        return buffer;
+    }
+
+    /** Decodes the whole file on the calling thread, in chunks, and returns the buffer, or
+        nullptr if the hooks cancelled it part way through.
+    */
+    static ReferenceCountedBuffer::Ptr decodeNow (const String& name, AudioFormatReader& reader,
+                                                  SampleFormat format = SampleFormat::float32, int chunkSize = 1 << 16,
+                                                  Hooks hooks = {})
+    {
+        jassert (chunkSize > 0);
+
+        Decode::Ptr decode = new Decode (createBuffer (name, reader, format), {}, chunkSize, std::move (hooks));
+        decode->nextChunk = 0;
+        decode->decodeRemainingChunks (reader);
+
+        return decode->buffer->isFullyLoaded() ? decode->buffer : nullptr;
+    }
+
+private:
+    static ReferenceCountedBuffer::Ptr createBuffer (const String& name, const AudioFormatReader& reader, SampleFormat format)
+    {
+        ReferenceCountedBuffer::Ptr buffer = new ReferenceCountedBuffer (name, (int) reader.numChannels, (int) reader.lengthInSamples, format);
+        buffer->setSampleRate (reader.sampleRate);
+        buffer->setNumValidSamples (0);
+        return buffer;
+    }
+
+    /** The state shared by the jobs decoding one file. */
+    struct Decode  : public ReferenceCountedObject
+    {
+        using Ptr = ReferenceCountedObjectPtr<Decode>;
+
+        Decode (ReferenceCountedBuffer::Ptr bufferToFill, const File& fileToRead, int samplesPerChunk, Hooks hooksToUse)
+            : buffer (std::move (bufferToFill)),
+              file (fileToRead),
+              chunkSize (samplesPerChunk),
+              numChunks (jmax (1, (buffer->getNumSamples() + chunkSize - 1) / chunkSize)),
+              hooks (std::move (hooksToUse))
+        {
+            finished.insertMultiple (0, false, numChunks);
+        }
+
+        bool shouldStop() const
+        {
+            return hooks.shouldCancel != nullptr && hooks.shouldCancel();
+        }
+
+        /** Claims chunks one at a time until there are none left, or the decode is cancelled.
+            Each caller needs its own reader.
+        */
+        void decodeRemainingChunks (AudioFormatReader& reader)
+        {
+            while (! shouldStop())
+            {
+                const auto chunk = nextChunk.fetch_add (1);
+
+                if (chunk >= numChunks)
+                    break;
+
+                decodeChunk (reader, chunk);
+            }
+        }
+
+        void decodeChunk (AudioFormatReader& reader, int chunk)
+        {
+            const TraceRecorder::Span span { *trace, "decode chunk", chunk };
+            const auto start = chunk * chunkSize;
+            const auto numSamples = jmin (chunkSize, buffer->getNumSamples() - start);
+
+            if (buffer->getSampleFormat() == SampleFormat::float32)
+            {
+                reader.read (&buffer->getDataRef(), start, numSamples, start, true, true);
+            }
+            else
+            {
+                // compact buffers are decoded to float first and converted as they're stored
+                AudioBuffer<float> decoded (buffer->getNumChannels(), numSamples);
+                reader.read (&decoded, 0, numSamples, start, true, true);
+
+                for (int channel = 0; channel < decoded.getNumChannels(); ++channel)
+                    buffer->write (channel, start, decoded.getReadPointer (channel), numSamples);
+            }
+
+            auto isComplete = false;
+
+            {
+                const ScopedLock sl (lock);
+                finished.set (chunk, true);
+
+                while (firstUnfinished < numChunks && finished[firstUnfinished])
+                    ++firstUnfinished;
+
+                // the loop guard copies from both ends of the file, so it can only be built at the end;
+                // the audio thread ignores it until it's built, and the watermark only reaches the end after that
+                isComplete = firstUnfinished == numChunks;
+
+                if (isComplete)
+                    buffer->updateLoopGuard();
+
+                buffer->setNumValidSamples (jmin (firstUnfinished * chunkSize, buffer->getNumSamples()));
+            }
+
+            if (isComplete && hooks.onFullyLoaded != nullptr)
+                hooks.onFullyLoaded (buffer);
+        }
+
+        const ReferenceCountedBuffer::Ptr buffer;
+        const File file;
+        const int chunkSize, numChunks;
+        const Hooks hooks;
+        SharedResourcePointer<TraceRecorder> trace;
+
+        std::atomic<int> nextChunk { 1 };   // chunk 0 is decoded before the buffer is returned
+
+        CriticalSection firstReaderLock;    // held by a job decoding with load()'s reader
+
+        CriticalSection lock;
+        Array<bool> finished;
+        int firstUnfinished = 0;
+    };
+
+    static bool canSeekCheaply (const AudioFormatReader& reader)
+    {
+        const auto& format = reader.getFormatName();
+        return format.startsWithIgnoreCase ("WAV") || format.startsWithIgnoreCase ("AIFF") || format.startsWithIgnoreCase ("FLAC");
+    }
+};
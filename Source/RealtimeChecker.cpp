@@ -0,0 +1,388 @@
+/*
+  ==============================================================================
+
+    RealtimeChecker.cpp
+    Created: 16 Oct 2026 11:08:30pm
+    Author:  HFM
+
+    The libc interposers behind RealtimeChecker. The executable's definitions of
+    these functions take precedence over libc's, so every call made through the
+    PLT - from this app, from JUCE or from libstdc++ - lands here first.
+
+  ==============================================================================
+*/
+
+// some of the functions replaced below would otherwise be defined inline by _FORTIFY_SOURCE
+#undef _FORTIFY_SOURCE
+
+#include "RealtimeChecker.h"
+
+#if LOOPER_REALTIME_CHECKS
+
+#if ! JUCE_LINUX
+ #error "The real-time checks work by interposing glibc functions, so they're Linux only"
+#endif
+
+#if defined (__SANITIZE_ADDRESS__) || defined (__SANITIZE_THREAD__)
+ #error "The real-time checks interpose the same functions as the sanitizers, so build them separately"
+#endif
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <unistd.h>
+#include <cstdarg>
+#include <cstdio>
+
+extern "C"
+{
+    void* __libc_malloc (size_t);
+    void* __libc_calloc (size_t, size_t);
+    void* __libc_realloc (void*, size_t);
+    void* __libc_memalign (size_t, size_t);
+    void  __libc_free (void*);
+}
+
+namespace RealtimeChecker
+{
+    namespace
+    {
+        thread_local int audioThreadDepth = 0;
+        thread_local int uncheckedCallDepth = 0;
+        thread_local bool isReporting = false;
+
+        std::atomic<uint64> numViolations { 0 };
+        std::atomic<uint64> reportedStacks[512] {};
+        bool abortOnViolation = false;
+
+        bool shouldTrap() noexcept
+        {
+            return audioThreadDepth > 0 && uncheckedCallDepth == 0 && ! isReporting;
+        }
+
+        /** Records a stack's hash, returning false if it had already been seen (or the table is full). */
+        bool isNewStack (uint64 hash) noexcept
+        {
+            const auto numSlots = (uint64) std::size (reportedStacks);
+
+            for (uint64 i = 0; i < numSlots; ++i)
+            {
+                auto& slot = reportedStacks[(hash + i) % numSlots];
+                auto existing = slot.load();
+
+                if (existing == 0 && slot.compare_exchange_strong (existing, hash))
+                    return true;
+
+                // the slot was taken already, or another thread just took it
+                if (existing == hash)
+                    return false;
+            }
+
+            return false;
+        }
+
+        void report (const char* functionName) noexcept
+        {
+            isReporting = true;
+            numViolations.fetch_add (1);
+
+            void* frames[48];
+            const auto numFrames = backtrace (frames, (int) std::size (frames));
+
+            // FNV-1a over the return addresses, so each offending call site is printed once
+            auto hash = (uint64) 14695981039346656037ull;
+
+            for (int i = 0; i < numFrames; ++i)
+                hash = (hash ^ (uint64) (pointer_sized_uint) frames[i]) * 1099511628211ull;
+
+            if (isNewStack (hash | 1))
+            {
+                char header[192];
+                const auto length = std::snprintf (header, sizeof (header),
+                                                   "\n*** Real-time violation: %s() called on the audio thread\n", functionName);
+
+                if (length > 0)
+                    ::write (STDERR_FILENO, header, (size_t) jmin (length, (int) sizeof (header) - 1));
+
+                // the first two frames are this function and the interposer
+                backtrace_symbols_fd (frames + 2, numFrames - 2, STDERR_FILENO);
+            }
+
+            if (abortOnViolation)
+                std::abort();
+
+            isReporting = false;
+        }
+
+        void check (const char* functionName) noexcept
+        {
+            if (shouldTrap())
+                report (functionName);
+        }
+
+        /** Looks up the next definition of a libc function, i.e. the one this file is hiding. */
+        template <typename FunctionPointer>
+        FunctionPointer getNext (std::atomic<FunctionPointer>& cached, const char* name) noexcept
+        {
+            auto* function = cached.load (std::memory_order_relaxed);
+
+            if (function == nullptr)
+            {
+                function = reinterpret_cast<FunctionPointer> (dlsym (RTLD_NEXT, name));
+                cached.store (function, std::memory_order_relaxed);
+            }
+
+            return function;
+        }
+
+        /** Reads the environment and gets the lookups that can allocate done before any audio starts. */
+        struct Initialiser
+        {
+            Initialiser()
+            {
+                if (auto* value = std::getenv ("LOOPER_REALTIME_CHECKS_ABORT"))
+                    abortOnViolation = *value != 0 && *value != '0';
+
+                // backtrace() loads libgcc the first time it's called, which allocates
+                void* frames[2];
+                backtrace (frames, 2);
+            }
+        };
+
+        Initialiser initialiser;
+    }
+
+    void enterAudioThread() noexcept    { ++audioThreadDepth; }
+    void leaveAudioThread() noexcept    { --audioThreadDepth; }
+    void enterUncheckedCall() noexcept  { ++uncheckedCallDepth; }
+    void leaveUncheckedCall() noexcept  { --uncheckedCallDepth; }
+
+    uint64 getNumViolations() noexcept  { return numViolations.load(); }
+}
+
+//==============================================================================
+extern "C"
+{
+    // memory
+    void* malloc (size_t size) noexcept
+    {
+        RealtimeChecker::check ("malloc");
+        return __libc_malloc (size);
+    }
+
+    void* calloc (size_t count, size_t size) noexcept
+    {
+        RealtimeChecker::check ("calloc");
+        return __libc_calloc (count, size);
+    }
+
+    void* realloc (void* block, size_t size) noexcept
+    {
+        RealtimeChecker::check ("realloc");
+        return __libc_realloc (block, size);
+    }
+
+    void free (void* block) noexcept
+    {
+        if (block != nullptr)
+            RealtimeChecker::check ("free");
+
+        __libc_free (block);
+    }
+
+    void* memalign (size_t alignment, size_t size) noexcept
+    {
+        RealtimeChecker::check ("memalign");
+        return __libc_memalign (alignment, size);
+    }
+
+    void* aligned_alloc (size_t alignment, size_t size) noexcept
+    {
+        RealtimeChecker::check ("aligned_alloc");
+        return __libc_memalign (alignment, size);
+    }
+
+    int posix_memalign (void** result, size_t alignment, size_t size) noexcept
+    {
+        RealtimeChecker::check ("posix_memalign");
+
+        if (alignment < sizeof (void*) || (alignment & (alignment - 1)) != 0)
+            return EINVAL;
+
+        *result = __libc_memalign (alignment, size);
+        return *result != nullptr || size == 0 ? 0 : ENOMEM;
+    }
+
+    void* mmap (void* address, size_t length, int protection, int flags, int fd, off_t offset) noexcept
+    {
+        RealtimeChecker::check ("mmap");
+        static std::atomic<void* (*) (void*, size_t, int, int, int, off_t)> next { nullptr };
+        return RealtimeChecker::getNext (next, "mmap") (address, length, protection, flags, fd, offset);
+    }
+
+    int munmap (void* address, size_t length) noexcept
+    {
+        RealtimeChecker::check ("munmap");
+        static std::atomic<int (*) (void*, size_t)> next { nullptr };
+        return RealtimeChecker::getNext (next, "munmap") (address, length);
+    }
+
+    // locks
+    int pthread_mutex_lock (pthread_mutex_t* mutex) noexcept
+    {
+        RealtimeChecker::check ("pthread_mutex_lock");
+        static std::atomic<int (*) (pthread_mutex_t*)> next { nullptr };
+        return RealtimeChecker::getNext (next, "pthread_mutex_lock") (mutex);
+    }
+
+    int pthread_rwlock_rdlock (pthread_rwlock_t* lock) noexcept
+    {
+        RealtimeChecker::check ("pthread_rwlock_rdlock");
+        static std::atomic<int (*) (pthread_rwlock_t*)> next { nullptr };
+        return RealtimeChecker::getNext (next, "pthread_rwlock_rdlock") (lock);
+    }
+
+    int pthread_rwlock_wrlock (pthread_rwlock_t* lock) noexcept
+    {
+        RealtimeChecker::check ("pthread_rwlock_wrlock");
+        static std::atomic<int (*) (pthread_rwlock_t*)> next { nullptr };
+        return RealtimeChecker::getNext (next, "pthread_rwlock_wrlock") (lock);
+    }
+
+    int pthread_join (pthread_t thread, void** result)
+    {
+        RealtimeChecker::check ("pthread_join");
+        static std::atomic<int (*) (pthread_t, void**)> next { nullptr };
+        return RealtimeChecker::getNext (next, "pthread_join") (thread, result);
+    }
+
+    int sem_wait (sem_t* semaphore)
+    {
+        RealtimeChecker::check ("sem_wait");
+        static std::atomic<int (*) (sem_t*)> next { nullptr };
+        return RealtimeChecker::getNext (next, "sem_wait") (semaphore);
+    }
+
+    int sched_yield() noexcept
+    {
+        RealtimeChecker::check ("sched_yield");
+        static std::atomic<int (*)()> next { nullptr };
+        return RealtimeChecker::getNext (next, "sched_yield") ();
+    }
+
+    // sleeping
+    int nanosleep (const timespec* duration, timespec* remaining)
+    {
+        RealtimeChecker::check ("nanosleep");
+        static std::atomic<int (*) (const timespec*, timespec*)> next { nullptr };
+        return RealtimeChecker::getNext (next, "nanosleep") (duration, remaining);
+    }
+
+    int clock_nanosleep (clockid_t clock, int flags, const timespec* duration, timespec* remaining)
+    {
+        RealtimeChecker::check ("clock_nanosleep");
+        static std::atomic<int (*) (clockid_t, int, const timespec*, timespec*)> next { nullptr };
+        return RealtimeChecker::getNext (next, "clock_nanosleep") (clock, flags, duration, remaining);
+    }
+
+    int usleep (useconds_t microseconds)
+    {
+        RealtimeChecker::check ("usleep");
+        static std::atomic<int (*) (useconds_t)> next { nullptr };
+        return RealtimeChecker::getNext (next, "usleep") (microseconds);
+    }
+
+    unsigned int sleep (unsigned int seconds)
+    {
+        RealtimeChecker::check ("sleep");
+        static std::atomic<unsigned int (*) (unsigned int)> next { nullptr };
+        return RealtimeChecker::getNext (next, "sleep") (seconds);
+    }
+
+    // I/O
+    int open (const char* path, int flags, ...)
+    {
+        RealtimeChecker::check ("open");
+
+        mode_t mode = 0;
+
+        if ((flags & O_CREAT) != 0 || (flags & O_TMPFILE) == O_TMPFILE)
+        {
+            va_list args;
+            va_start (args, flags);
+            mode = (mode_t) va_arg (args, int);
+            va_end (args);
+        }
+
+        static std::atomic<int (*) (const char*, int, ...)> next { nullptr };
+        return RealtimeChecker::getNext (next, "open") (path, flags, mode);
+    }
+
+    int openat (int directory, const char* path, int flags, ...)
+    {
+        RealtimeChecker::check ("openat");
+
+        mode_t mode = 0;
+
+        if ((flags & O_CREAT) != 0 || (flags & O_TMPFILE) == O_TMPFILE)
+        {
+            va_list args;
+            va_start (args, flags);
+            mode = (mode_t) va_arg (args, int);
+            va_end (args);
+        }
+
+        static std::atomic<int (*) (int, const char*, int, ...)> next { nullptr };
+        return RealtimeChecker::getNext (next, "openat") (directory, path, flags, mode);
+    }
+
+    ssize_t read (int fd, void* data, size_t size)
+    {
+        RealtimeChecker::check ("read");
+        static std::atomic<ssize_t (*) (int, void*, size_t)> next { nullptr };
+        return RealtimeChecker::getNext (next, "read") (fd, data, size);
+    }
+
+    ssize_t write (int fd, const void* data, size_t size)
+    {
+        RealtimeChecker::check ("write");
+        static std::atomic<ssize_t (*) (int, const void*, size_t)> next { nullptr };
+        return RealtimeChecker::getNext (next, "write") (fd, data, size);
+    }
+
+    ssize_t pread (int fd, void* data, size_t size, off_t offset)
+    {
+        RealtimeChecker::check ("pread");
+        static std::atomic<ssize_t (*) (int, void*, size_t, off_t)> next { nullptr };
+        return RealtimeChecker::getNext (next, "pread") (fd, data, size, offset);
+    }
+
+    int fsync (int fd)
+    {
+        RealtimeChecker::check ("fsync");
+        static std::atomic<int (*) (int)> next { nullptr };
+        return RealtimeChecker::getNext (next, "fsync") (fd);
+    }
+
+    int poll (pollfd* fds, nfds_t numFds, int timeout)
+    {
+        RealtimeChecker::check ("poll");
+        static std::atomic<int (*) (pollfd*, nfds_t, int)> next { nullptr };
+        return RealtimeChecker::getNext (next, "poll") (fds, numFds, timeout);
+    }
+
+    int select (int numFds, fd_set* readFds, fd_set* writeFds, fd_set* exceptFds, timeval* timeout)
+    {
+        RealtimeChecker::check ("select");
+        static std::atomic<int (*) (int, fd_set*, fd_set*, fd_set*, timeval*)> next { nullptr };
+        return RealtimeChecker::getNext (next, "select") (numFds, readFds, writeFds, exceptFds, timeout);
+    }
+}
+
+#endif
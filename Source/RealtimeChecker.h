@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    RealtimeChecker.h
+    Created: 16 Oct 2026 11:08:30pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/** Build with LOOPER_REALTIME_CHECKS=1 (e.g. CXXFLAGS="-DLOOPER_REALTIME_CHECKS=1" with the
+    Linux makefile) to have every allocation, free, lock and blocking call made on a marked
+    audio thread reported to stderr with a stack trace.
+*/
+#ifndef LOOPER_REALTIME_CHECKS
+ #define LOOPER_REALTIME_CHECKS 0
+#endif
+
+/** A debugging mode that catches the audio thread doing things it must never do.
+
+    The audio callback marks its thread with a ScopedAudioThread. With the checks compiled
+    in, RealtimeChecker.cpp interposes the libc functions behind malloc/free (and so new
+    and delete), mutexes (and so CriticalSection and WaitableEvent), contended SpinLocks
+    (which fall back to sched_yield), sleeping, file and socket I/O and memory mapping.
+    Any of those called while a thread is marked is counted, and the first call from each
+    distinct call stack is reported with a backtrace.
+
+    Set LOOPER_REALTIME_CHECKS_ABORT=1 in the environment to abort on the first violation
+    instead, so that CI fails at the offending call. Linux only; it can't be combined with
+    AddressSanitizer or ThreadSanitizer, which interpose the same functions.
+
+    Without LOOPER_REALTIME_CHECKS all of this compiles away to nothing.
+*/
+namespace RealtimeChecker
+{
+   #if LOOPER_REALTIME_CHECKS
+    void enterAudioThread() noexcept;
+    void leaveAudioThread() noexcept;
+    void enterUncheckedCall() noexcept;
+    void leaveUncheckedCall() noexcept;
+
+    /** The number of violations caught so far, across all threads. */
+    uint64 getNumViolations() noexcept;
+   #else
+    inline void enterAudioThread() noexcept     {}
+    inline void leaveAudioThread() noexcept     {}
+    inline void enterUncheckedCall() noexcept   {}
+    inline void leaveUncheckedCall() noexcept   {}
+    inline uint64 getNumViolations() noexcept   { return 0; }
+   #endif
+
+    /** Marks the calling thread as the audio thread for as long as it exists. Nests. */
+    class ScopedAudioThread
+    {
+    public:
+        ScopedAudioThread() noexcept    { enterAudioThread(); }
+        ~ScopedAudioThread() noexcept   { leaveAudioThread(); }
+
+    private:
+        JUCE_DECLARE_NON_COPYABLE (ScopedAudioThread)
+    };
+
+    /** Lifts the checks for a call the audio thread makes knowingly and rarely, such as
+        waking a parked thread, so that it isn't counted as a violation.
+    */
+    class ScopedUncheckedCall
+    {
+    public:
+        ScopedUncheckedCall() noexcept  { enterUncheckedCall(); }
+        ~ScopedUncheckedCall() noexcept { leaveUncheckedCall(); }
+
+    private:
+        JUCE_DECLARE_NON_COPYABLE (ScopedUncheckedCall)
+    };
+}
@@ -0,0 +1,91 @@
+/*
+  ==============================================================================
+
+    RealtimeHandoff.h
+    Created: 16 Oct 2026 10:41:50pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ReleasePool.h"
+
+/** Publishes a reference-counted object from any thread to the audio thread.
+
+    Writers call publish(). The audio thread only ever loads a raw pointer with
+    getForAudioThread(), which is a single atomic load: no lock, no allocation and no
+    reference count changes. Ownership stays with the handoff, and whatever gets
+    replaced is passed to the ReleasePool, which releases it once the audio callback
+    that might still be using it has returned.
+
+    The audio thread must hold an AudioThreadEpoch::ScopedCallback on the same epoch
+    for as long as it uses the pointer it got.
+*/
+template <typename ObjectType>
+class RealtimeHandoff
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<ObjectType>;
+
+    explicit RealtimeHandoff (ReleasePool& poolToRetireInto)
+        : releasePool (poolToRetireInto)
+    {
+    }
+
+    ~RealtimeHandoff()
+    {
+        current.store (nullptr);
+    }
+
+    /** Makes newObject the current object and retires the previous one. Not for the audio thread. */
+    void publish (Ptr newObject)
+    {
+        const ScopedLock sl (writerLock);
+        trace->instant ("publish", TraceRecorder::getId (newObject.get()));
+
+        current.store (newObject.get());
+        numPublished.fetch_add (1, std::memory_order_relaxed);
+        auto previous = std::exchange (owner, std::move (newObject));
+
+        // must happen after the store above, so the pool's epoch snapshot covers
+        // every callback that could still have loaded the old pointer
+        releasePool.retire (std::move (previous));
+    }
+
+    /** Returns a counted reference to the current object. Not for the audio thread. */
+    Ptr get() const
+    {
+        const ScopedLock sl (writerLock);
+        return owner;
+    }
+
+    /** Returns the current object without touching its reference count. Wait-free. */
+    ObjectType* getForAudioThread() const noexcept
+    {
+        return current.load();
+    }
+
+    /** Counts calls to publish(). Comparing it before and after a callback shows whether a
+        publish landed during the callback, which is where a lock would have been contended.
+    */
+    uint32 getNumPublished() const noexcept
+    {
+        return numPublished.load (std::memory_order_relaxed);
+    }
+
+private:
+    ReleasePool& releasePool;
+    SharedResourcePointer<TraceRecorder> trace;
+
+    std::atomic<ObjectType*> current { nullptr };
+    std::atomic<uint32> numPublished { 0 };
+
+    CriticalSection writerLock;
+    Ptr owner;
+
+    static_assert (std::atomic<ObjectType*>::is_always_lock_free, "The audio thread must never lock");
+
+    JUCE_DECLARE_NON_COPYABLE (RealtimeHandoff)
+};
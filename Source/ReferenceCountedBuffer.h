@@ -11,30 +11,421 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "MappedWavFile.h"
+#include "SampleStorage.h"
+#include "SampleMemoryPool.h"
 
 class ReferenceCountedBuffer : public ReferenceCountedObject
 {
 public:
-    ReferenceCountedBuffer (const String& name, int numChannels, int numSamples)
+    /** Creates a buffer that keeps its samples in the given format. Anything other than float32 is
+        converted as it's written with write() and again as it's read, so getDataRef() and
+        getReadPointer() are only available for float32 buffers.
+     
+        The samples live in a block from the SampleMemoryPool, which goes back to the pool when the
+        buffer is deleted, and start out undefined: write all of them before they're marked as valid.
+        Throws std::bad_alloc if the pool can't supply them, so a load has to catch that.
+    */
+    ReferenceCountedBuffer (const String& name, int numChannels, int numSamples, SampleFormat format = SampleFormat::float32)
     :
     name (name),
-    data (numChannels, numSamples)
+    format (format),
+    validSamples (numSamples),
+    loopRegion (0, numSamples)
     {
+        // each channel starts on a 64-byte boundary
+        const auto bytesPerSample = SampleConversion::getBytesPerSample (format);
+        const auto channelStride = ((size_t) numSamples * bytesPerSample + 63) / 64 * 64;
+        
+        pooledSamples = memoryPool->allocate ((size_t) numChannels * channelStride);
+        auto* firstChannel = static_cast<char*> (pooledSamples.getData ());
+        
+        if (firstChannel == nullptr && numChannels > 0 && numSamples > 0)
+            throw std::bad_alloc();
+        
+        if (format == SampleFormat::float32)
+        {
+            channelPointers.allocate ((size_t) jmax (1, numChannels), true);
+            
+            for (int channel = 0; channel < numChannels; ++channel)
+                channelPointers[channel] = reinterpret_cast<float*> (firstChannel + (size_t) channel * channelStride);
+            
+            data.setDataToReferTo (channelPointers, numChannels, numSamples);
+        }
+        else
+        {
+            compact.numChannels = numChannels;
+            compact.numSamples = numSamples;
+            compact.base = reinterpret_cast<uint16*> (firstChannel);
+            compact.channelStride = channelStride / sizeof (uint16);
+        }
+        
         DBG ("Created buffer: " << name);
     }
     
+    /** Creates a buffer that plays straight from a memory-mapped WAV file instead of owning its samples. */
+    ReferenceCountedBuffer (const String& name, std::unique_ptr<MappedWavFile> mappedFile)
+    :
+    name (name),
+    mapped (std::move (mappedFile)),
+    validSamples (mapped->getNumSamples ()),
+    loopRegion (0, mapped->getNumSamples ())
+    {
+        setLoopRegion (loopRegion);
+        DBG ("Mapped buffer: " << name);
+    }
+    
+    /** Creates a buffer that reads samples held in someone else's memory, such as a mapped SampleBank,
+        with each channel channelStride bytes after the one before. The owner is kept alive for as long
+        as the buffer is, and the samples are never written to.
+    */
+    ReferenceCountedBuffer (const String& name, SampleFormat format, const char* firstChannel, size_t channelStride,
+                            int numChannels, int numSamples, double sampleRate,
+                            ReferenceCountedObjectPtr<ReferenceCountedObject> owner)
+    :
+    name (name),
+    format (format),
+    externalOwner (std::move (owner)),
+    sampleRate (sampleRate),
+    validSamples (numSamples),
+    loopRegion (0, numSamples)
+    {
+        jassert (externalOwner != nullptr && channelStride % sizeof (float) == 0);
+        
+        if (format == SampleFormat::float32)
+        {
+            channelPointers.allocate ((size_t) jmax (1, numChannels), true);
+            
+            for (int channel = 0; channel < numChannels; ++channel)
+                channelPointers[channel] = reinterpret_cast<float*> (const_cast<char*> (firstChannel + (size_t) channel * channelStride));
+            
+            data.setDataToReferTo (channelPointers, numChannels, numSamples);
+        }
+        else
+        {
+            compact.numChannels = numChannels;
+            compact.numSamples = numSamples;
+            compact.base = reinterpret_cast<uint16*> (const_cast<char*> (firstChannel));
+            compact.channelStride = channelStride / sizeof (uint16);
+        }
+        
+        DBG ("External buffer: " << name);
+    }
+    
     ~ReferenceCountedBuffer ()
     {
         DBG ("Deleted buffer: " << name);
     }
     
-    AudioBuffer<float>& getDataRef () { return data; }
+    /** Decodes a whole file into a float32 buffer that loops all of it, or returns nullptr if it
+        can't be read. Not for the audio thread.
+    */
+    static ReferenceCountedObjectPtr<ReferenceCountedBuffer> createFromFile (AudioFormatManager& formatManager, const File& file)
+    {
+        std::unique_ptr<AudioFormatReader> reader (formatManager.createReaderFor (file));
+        
+        if (reader == nullptr)
+            return nullptr;
+        
+        ReferenceCountedObjectPtr<ReferenceCountedBuffer> result = new ReferenceCountedBuffer (file.getFileNameWithoutExtension (),
+                                                                                               (int) reader->numChannels,
+                                                                                               (int) reader->lengthInSamples);
+        reader->read (&result->getDataRef (), 0, (int) reader->lengthInSamples, 0, true, true);
+        result->setSampleRate (reader->sampleRate);
+        result->setLoopRegion ({ 0, result->getNumSamples () });
+        return result;
+    }
+    
+    /** Makes a copy of a buffer that stores its samples in a different format. Not for the audio thread. */
+    static ReferenceCountedObjectPtr<ReferenceCountedBuffer> createCopy (const String& name, const ReferenceCountedBuffer& source,
+                                                                         SampleFormat newFormat)
+    {
+        jassert (source.isFullyLoaded ());
+        
+        ReferenceCountedObjectPtr<ReferenceCountedBuffer> result = new ReferenceCountedBuffer (name, source.getNumChannels (),
+                                                                                               source.getNumSamples (), newFormat);
+        result->setSampleRate (source.getSampleRate ());
+        
+        HeapBlock<float> scratch ((size_t) maxContiguousRead);
+        
+        for (int channel = 0; channel < source.getNumChannels (); ++channel)
+        {
+            for (int start = 0; start < source.getNumSamples (); start += maxContiguousRead)
+            {
+                const auto numThisTime = jmin (maxContiguousRead, source.getNumSamples () - start);
+                source.read (channel, start, scratch, numThisTime);
+                result->write (channel, start, scratch, numThisTime);
+            }
+        }
+        
+        result->setLoopRegion (source.getLoopRegion (), source.getLoopCrossfadeLength ());
+        return result;
+    }
+    
+    /** The decoded samples. Only valid for float32 buffers that aren't memory-mapped. */
+    AudioBuffer<float>& getDataRef () { jassert (! needsConversionOnRead () && ! isMemoryMapped ()); return data; }
+    
+    const String& getName () const noexcept     { return name; }
+    bool isMemoryMapped () const noexcept       { return mapped != nullptr || externalOwner != nullptr; }
+    SampleFormat getSampleFormat () const noexcept  { return format; }
+    
+    /** True if the samples can't be read in place, because they are mapped or stored in a compact format. */
+    bool needsConversionOnRead () const noexcept    { return mapped != nullptr || format != SampleFormat::float32; }
+    
+    int getNumChannels () const noexcept
+    {
+        return mapped != nullptr ? mapped->getNumChannels () : (format == SampleFormat::float32 ? data.getNumChannels () : compact.numChannels);
+    }
+    
+    int getNumSamples () const noexcept
+    {
+        return mapped != nullptr ? mapped->getNumSamples () : (format == SampleFormat::float32 ? data.getNumSamples () : compact.numSamples);
+    }
+    
+    /** How many samples from the start have been loaded. While a buffer is still being decoded this
+        is less than getNumSamples(), and the audio thread mustn't read beyond it.
+    */
+    int getNumValidSamples () const noexcept            { return validSamples.load (std::memory_order_acquire); }
+    bool isFullyLoaded () const noexcept                { return getNumValidSamples () >= getNumSamples (); }
+    void setNumValidSamples (int newNumValid) noexcept  { validSamples.store (newNumValid, std::memory_order_release); }
+    
+    /** The memory this buffer holds on to. Mapped buffers live in the page cache, so they count as nothing. */
+    size_t getSizeInBytes () const noexcept
+    {
+        return isMemoryMapped () ? 0 : (size_t) getNumChannels () * (size_t) getNumSamples () * SampleConversion::getBytesPerSample (format);
+    }
+    
+    /** The rate the samples were recorded at, or 0 if unknown. */
+    double getSampleRate () const noexcept  { return mapped != nullptr ? mapped->getSampleRate () : sampleRate; }
+    void setSampleRate (double newSampleRate) noexcept  { jassert (! isMemoryMapped ()); sampleRate = newSampleRate; }
+    
+    /** Returns a pointer to the stored samples, or nullptr if they have to be converted with read(). */
+    const float* getReadPointer (int channel, int sampleIndex) const noexcept
+    {
+        return needsConversionOnRead () ? nullptr : data.getReadPointer (channel, sampleIndex);
+    }
+    
+    /** Stores (and if necessary converts) samples into one channel, e.g. while the buffer is being loaded. */
+    void write (int destChannel, int destStartSample, const float* source, int numSamples) noexcept
+    {
+        jassert (! isMemoryMapped ());
+        
+        switch (format)
+        {
+            case SampleFormat::int16:
+                SampleConversion::floatToInt16 (reinterpret_cast<int16*> (compact.getChannel (destChannel) + destStartSample), source, numSamples);
+                break;
+                
+            case SampleFormat::float16:
+                SampleConversion::floatToHalf (compact.getChannel (destChannel) + destStartSample, source, numSamples);
+                break;
+                
+            case SampleFormat::float32:
+            default:
+                FloatVectorOperations::copy (data.getWritePointer (destChannel, destStartSample), source, numSamples);
+                break;
+        }
+    }
+    
+    /** Reads (and if necessary converts) samples from one channel. Safe to call on the audio thread. */
+    void read (int sourceChannel, int sourceStartSample, float* dest, int numSamples) const noexcept
+    {
+        if (mapped != nullptr)
+            mapped->read (sourceChannel, sourceStartSample, dest, numSamples);
+        else if (format == SampleFormat::int16)
+            SampleConversion::int16ToFloat (dest, reinterpret_cast<const int16*> (compact.getChannel (sourceChannel) + sourceStartSample), numSamples);
+        else if (format == SampleFormat::float16)
+            SampleConversion::halfToFloat (dest, compact.getChannel (sourceChannel) + sourceStartSample, numSamples);
+        else
+            FloatVectorOperations::copy (dest, data.getReadPointer (sourceChannel, sourceStartSample), numSamples);
+    }
+    
+    //==============================================================================
+    /** The longest span getLoopReadPointer() and readLoop() can return in one go. */
+    static constexpr int maxContiguousRead = 4096;
+    
+    Range<int> getLoopRegion () const noexcept          { return loopRegion; }
+    int getLoopCrossfadeLength () const noexcept        { return crossfadeLength; }
+    
+    /** Sets the region that plays in a loop and builds its guard samples.
+     
+        The guard holds the maxContiguousRead + crossfade samples before the loop end followed by
+        the maxContiguousRead samples from the loop start, so any read of up to maxContiguousRead
+        samples that runs over the loop end is one contiguous span instead of two.
+     
+        If crossfadeSamples is more than zero, the end of the loop is faded into the samples leading
+        up to the loop start with an equal-power curve. It's baked into the guard, so it costs nothing
+        to play. The fade is limited by how much audio there is before the loop start.
+     
+        Call this before the audio thread can see the buffer. If the samples aren't all in place
+        yet, the guard is left for updateLoopGuard() to build once they are.
+    */
+    void setLoopRegion (Range<int> newLoopRegion, int crossfadeSamples = 0)
+    {
+        newLoopRegion = newLoopRegion.getIntersectionWith ({ 0, getNumSamples () });
+        loopRegion = newLoopRegion.isEmpty () ? Range<int> (0, getNumSamples ()) : newLoopRegion;
+        crossfadeLength = jlimit (0, jmin (loopRegion.getLength () / 2, loopRegion.getStart ()), crossfadeSamples);
+        
+        loopGuardIsBuilt.store (false, std::memory_order_relaxed);
+        
+        if (isFullyLoaded ())
+            buildLoopGuard ();
+    }
+    
+    /** Builds the guard samples for the current loop region, for a buffer whose samples were
+        filled in after the region was set. A buffer that is still being decoded can call this as
+        its last chunk arrives, before the rest of the loop is marked as valid: the audio thread
+        doesn't touch the guard until it has been built, so it's safe while the buffer is playing.
+        
+        The guard can only be built once this way, because the audio thread may be reading it
+        from then on; a guard that has already been built is left as it is.
+    */
+    void updateLoopGuard ()
+    {
+        const auto isAlreadyBuilt = loopGuardIsBuilt.load (std::memory_order_relaxed);
+        jassert (! isAlreadyBuilt);
+        
+        if (! isAlreadyBuilt)
+            buildLoopGuard ();
+    }
+    
+    /** Returns a pointer to numSamples contiguous samples of the loop starting at position, running
+        on past the loop end into the loop start if need be. Returns nullptr if the samples have to be
+        converted with readLoop() instead.
+    */
+    const float* getLoopReadPointer (int channel, int position, int numSamples) const noexcept
+    {
+        jassert (numSamples <= maxContiguousRead && loopRegion.contains (position));
+        
+        if (position + numSamples <= loopRegion.getEnd () - crossfadeLength)
+            return getReadPointer (channel, position);
+        
+        // the guard isn't there until setLoopRegion() or updateLoopGuard() has finished building it
+        return loopGuardIsBuilt.load (std::memory_order_acquire) ? guard.getReadPointer (channel, position - getGuardStart ()) : nullptr;
+    }
+    
+    /** Reads numSamples of the loop starting at position, wrapping at the loop end. Safe to call on the audio thread. */
+    void readLoop (int channel, int position, float* dest, int numSamples) const noexcept
+    {
+        if (numSamples <= maxContiguousRead)
+        {
+            if (auto* source = getLoopReadPointer (channel, position, numSamples))
+            {
+                FloatVectorOperations::copy (dest, source, numSamples);
+                return;
+            }
+        }
+        
+        while (numSamples > 0)
+        {
+            const auto numThisTime = jmin (numSamples, loopRegion.getEnd () - position);
+            read (channel, position, dest, numThisTime);
+            
+            dest += numThisTime;
+            numSamples -= numThisTime;
+            position = advanceLoopPosition (position, numThisTime);
+        }
+    }
+    
+    /** Copies numSamples of the loop starting at position into dest. Safe to call on the audio thread. */
+    void copyLoopTo (AudioBuffer<float>& dest, int destChannel, int destStartSample,
+                     int sourceChannel, int position, int numSamples) const noexcept
+    {
+        readLoop (sourceChannel, position, dest.getWritePointer (destChannel, destStartSample), numSamples);
+    }
+    
+    /** Moves a position in the loop on by numSamples, wrapping at the loop end. */
+    int advanceLoopPosition (int position, int numSamples) const noexcept
+    {
+        position += numSamples;
+        
+        if (position >= loopRegion.getEnd ())
+            position = loopRegion.getStart () + (position - loopRegion.getStart ()) % loopRegion.getLength ();
+        
+        return position;
+    }
     
     using Ptr = ReferenceCountedObjectPtr<ReferenceCountedBuffer>;
     
 private:
+    int getGuardStart () const noexcept     { return loopRegion.getEnd () - crossfadeLength - maxContiguousRead; }
+    
+    void buildLoopGuard ()
+    {
+        if (loopRegion.isEmpty ())
+            return;
+        
+        guard.setSize (getNumChannels (), 2 * maxContiguousRead + crossfadeLength);
+        
+        for (int channel = 0; channel < guard.getNumChannels (); ++channel)
+            for (int i = 0; i < guard.getNumSamples (); ++i)
+                guard.setSample (channel, i, getLoopedSample (channel, getGuardStart () + i));
+        
+        loopGuardIsBuilt.store (true, std::memory_order_release);
+    }
+    
+    /** The sample heard at any index when the loop repeats forever, including the crossfade. */
+    float getLoopedSample (int channel, int index) const noexcept
+    {
+        const auto length = loopRegion.getLength ();
+        auto offset = (index - loopRegion.getStart ()) % length;
+        
+        if (offset < 0)
+            offset += length;
+        
+        auto sample = getSample (channel, loopRegion.getStart () + offset);
+        const auto fadePosition = offset - (length - crossfadeLength);
+        
+        if (fadePosition >= 0)
+        {
+            const auto angle = MathConstants<float>::halfPi * ((float) fadePosition + 0.5f) / (float) crossfadeLength;
+            const auto preRoll = getSample (channel, loopRegion.getStart () - crossfadeLength + fadePosition);
+            sample = sample * std::cos (angle) + preRoll * std::sin (angle);
+        }
+        
+        return sample;
+    }
+    
+    float getSample (int channel, int index) const noexcept
+    {
+        float sample = 0.0f;
+        read (channel, index, &sample, 1);
+        return sample;
+    }
+    
+
+    /** Samples kept as 16-bit values (int16 or half bits), one channel after another, either in
+        pooled or in external memory.
+    */
+    struct CompactStorage
+    {
+        uint16* getChannel (int channel) noexcept               { return base + (size_t) channel * channelStride; }
+        const uint16* getChannel (int channel) const noexcept   { return base + (size_t) channel * channelStride; }
+        
+        uint16* base = nullptr;
+        size_t channelStride = 0;
+        int numChannels = 0, numSamples = 0;
+    };
+    
     const String name;
+    const SampleFormat format = SampleFormat::float32;
+    
+    // declared first so that it outlives the block the samples are in
+    SharedResourcePointer<SampleMemoryPool> memoryPool;
+    SampleMemoryPool::Block pooledSamples;
+    
     AudioBuffer<float> data;
+    CompactStorage compact;
+    std::unique_ptr<MappedWavFile> mapped;
+    ReferenceCountedObjectPtr<ReferenceCountedObject> externalOwner;
+    HeapBlock<float*> channelPointers;
+    double sampleRate = 0.0;
+    std::atomic<int> validSamples;
+    
+    Range<int> loopRegion;
+    int crossfadeLength = 0;
+    AudioBuffer<float> guard;
+    std::atomic<bool> loopGuardIsBuilt { false };
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ReferenceCountedBuffer)
 };
@@ -0,0 +1,245 @@
+/*
+  ==============================================================================
+
+    ReleasePool.h
+    Created: 16 Oct 2026 10:41:50pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "TraceRecorder.h"
+
+/** Counts the audio thread's entries into and exits from its callback.
+
+    The counter is odd while the audio thread is inside getNextAudioBlock() and even
+    otherwise. Entering and leaving are one atomic increment each, so the audio thread
+    never waits; other threads use snapshot() and hasPassed() to find out whether the
+    audio thread can still be holding on to something it saw earlier.
+
+    For the rare object the audio thread needs beyond the end of the callback it found it
+    in (e.g. a buffer that's still fading out), it can also publish a Hazard.
+*/
+class AudioThreadEpoch
+{
+public:
+    AudioThreadEpoch() = default;
+
+    /** Marks the audio thread as being inside its callback while this object exists. */
+    class ScopedCallback
+    {
+    public:
+        explicit ScopedCallback (AudioThreadEpoch& epochToUse) noexcept : epoch (epochToUse)  { epoch.counter.fetch_add (1); }
+        ~ScopedCallback() noexcept                                                            { epoch.counter.fetch_add (1); }
+
+    private:
+        AudioThreadEpoch& epoch;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedCallback)
+    };
+
+    /** A pointer the audio thread keeps using across callbacks.
+
+        Set it during a callback to an object loaded in that same callback, and the object
+        stays alive until it's set to something else, even if it has been retired in the
+        meantime. Only the audio thread should set it. Constructing one claims one of a few
+        slots on the epoch, so do it before the audio starts.
+    */
+    class Hazard
+    {
+    public:
+        explicit Hazard (AudioThreadEpoch& epochToUse) noexcept
+            : epoch (epochToUse), slot (epoch.claimHazardSlot())
+        {
+        }
+
+        ~Hazard() noexcept
+        {
+            set (nullptr);
+            epoch.releaseHazardSlot (slot);
+        }
+
+        void set (const ReferenceCountedObject* object) noexcept
+        {
+            if (slot >= 0)
+                epoch.hazards[(size_t) slot].store (object);
+        }
+
+    private:
+        AudioThreadEpoch& epoch;
+        const int slot;
+
+        JUCE_DECLARE_NON_COPYABLE (Hazard)
+    };
+
+    uint32 snapshot() const noexcept                        { return counter.load(); }
+
+    /** True once every callback that was running when the snapshot was taken has returned. */
+    bool hasPassed (uint32 snapshotValue) const noexcept
+    {
+        return (snapshotValue & 1) == 0 || counter.load() != snapshotValue;
+    }
+
+    /** True while the audio thread has the object in one of its hazards. Check hasPassed() first. */
+    bool isProtected (const ReferenceCountedObject* object) const noexcept
+    {
+        for (auto& hazard : hazards)
+            if (hazard.load() == object)
+                return true;
+
+        return false;
+    }
+
+private:
+    static constexpr int maxHazards = 8;
+
+    int claimHazardSlot() noexcept
+    {
+        auto claimed = claimedHazards.load();
+
+        for (int slot = 0; slot < maxHazards; ++slot)
+        {
+            const auto bit = 1u << slot;
+
+            if ((claimed & bit) == 0 && claimedHazards.compare_exchange_strong (claimed, claimed | bit))
+                return slot;
+        }
+
+        jassertfalse;   // more hazards than maxHazards are alive at once
+        return -1;
+    }
+
+    void releaseHazardSlot (int slot) noexcept
+    {
+        if (slot >= 0)
+            claimedHazards.fetch_and (~(1u << slot));
+    }
+
+    std::atomic<uint32> counter { 0 };
+    std::array<std::atomic<const ReferenceCountedObject*>, maxHazards> hazards {};
+    std::atomic<uint32> claimedHazards { 0 };
+
+    static_assert (std::atomic<uint32>::is_always_lock_free, "The audio thread must never lock");
+
+    JUCE_DECLARE_NON_COPYABLE (AudioThreadEpoch)
+};
+
+//==============================================================================
+/** Drops the last reference to retired objects on a background thread.
+
+    Anything the audio thread might still be reading is handed to retire() instead of
+    being released in place. The pool keeps it alive until the audio callback that could
+    have seen it has returned, then releases it on its own thread, so destructors (and
+    the memory they free) never run on the audio thread.
+
+    Destroy the pool only after the audio device has been stopped.
+*/
+class ReleasePool  : private Thread
+{
+public:
+    using ObjectPtr = ReferenceCountedObjectPtr<ReferenceCountedObject>;
+
+    explicit ReleasePool (const AudioThreadEpoch& epochToWatch)
+        : Thread ("Release pool"),
+          epoch (epochToWatch)
+    {
+        startThread();
+    }
+
+    ~ReleasePool() override
+    {
+        stopThread (2000);
+    }
+
+    /** Queues an object for release.
+
+        Call this only after the object has been made unreachable for the audio thread
+        (e.g. after it was swapped out of a RealtimeHandoff). Must not be called from the
+        audio thread.
+    */
+    void retire (ObjectPtr object)
+    {
+        if (object == nullptr)
+            return;
+
+        trace->instant ("retire", TraceRecorder::getId (object.get()));
+
+        {
+            const ScopedLock sl (lock);
+            pending.add (Entry { std::move (object), epoch.snapshot() });
+        }
+
+        notify();
+    }
+
+    int getNumPending() const
+    {
+        const ScopedLock sl (lock);
+        return pending.size();
+    }
+
+private:
+    struct Entry
+    {
+        ObjectPtr object;
+        uint32 epochWhenRetired;
+    };
+
+    void run() override
+    {
+        trace->nameCurrentThread ("Release pool");
+
+        while (! threadShouldExit())
+        {
+            const auto anyStillPending = releaseRetiredObjects();
+
+            // while something is waiting for the audio thread to let go, poll at roughly
+            // callback granularity - the audio thread itself is never allowed to signal us.
+            wait (anyStillPending ? 1 : -1);
+        }
+    }
+
+    bool releaseRetiredObjects()
+    {
+        Array<Entry> toRelease;
+        bool anyStillPending = false;
+
+        {
+            const ScopedLock sl (lock);
+
+            for (int i = pending.size(); --i >= 0;)
+            {
+                const auto& entry = pending.getReference (i);
+
+                // a hazard can only be set during a callback, so check it once that callback is over
+                if (epoch.hasPassed (entry.epochWhenRetired) && ! epoch.isProtected (entry.object.get()))
+                {
+                    toRelease.add (std::move (pending.getReference (i)));
+                    pending.remove (i);
+                }
+            }
+
+            anyStillPending = ! pending.isEmpty();
+        }
+
+        // the destructors run here, outside the lock
+        for (auto& entry : toRelease)
+        {
+            const TraceRecorder::Span span { *trace, entry.object->getReferenceCount() == 1 ? "destroy" : "release",
+                                             TraceRecorder::getId (entry.object.get()) };
+            entry.object = nullptr;
+        }
+
+        return anyStillPending;
+    }
+
+    const AudioThreadEpoch& epoch;
+    SharedResourcePointer<TraceRecorder> trace;
+
+    CriticalSection lock;
+    Array<Entry> pending;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ReleasePool)
+};
@@ -0,0 +1,415 @@
+/*
+  ==============================================================================
+
+    SampleBank.h
+    Created: 16 Oct 2026 11:16:50pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "PolyphaseResampler.h"
+
+#if JUCE_LINUX || JUCE_MAC || JUCE_BSD || JUCE_ANDROID
+ #include <sys/mman.h>
+#endif
+
+/** A file of samples that were decoded ahead of time, played straight from a memory mapping.
+
+    Opening a bank reads nothing but its index, so a library that takes seconds to decode
+    from FLAC or Ogg is ready in however long it takes to map one file and read a few
+    hundred bytes per sample. createBuffer() hands out ReferenceCountedBuffers that read
+    the mapped samples in place, in whichever SampleFormat the bank was built with; the
+    pages come in from the OS page cache as they're first played and are shared with
+    every other buffer (or process) using the same bank.
+
+    The layout, all little-endian:
+
+        header      64 bytes: "LOOPBANK", version, alignment, number of entries
+        index       128 bytes per entry: name, format, channels, length, loop region,
+                    sample rate, data offset and the distance between channels
+        samples     each channel of each entry starts on an alignment boundary
+
+    The alignment is 16 KiB, which is a whole number of pages on every platform the app
+    runs on, so each channel starts on a page of its own and float32 channels are read
+    with no conversion at all.
+
+    Banks are built by build(), which the console tool exposes as --build-bank.
+*/
+class SampleBank  : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<SampleBank>;
+
+    struct Entry
+    {
+        String name;
+        SampleFormat format = SampleFormat::float32;
+        int numChannels = 0, numSamples = 0, crossfadeLength = 0;
+        Range<int> loopRegion;
+        double sampleRate = 0.0;
+        uint64 dataOffset = 0, channelStride = 0;     // in bytes
+    };
+
+    /** Maps a bank file and reads its index, or returns nullptr if it isn't a valid bank. */
+    static Ptr open (const File& file)
+    {
+        // the samples are used in place, so a big-endian machine can't read them
+        if (ByteOrder::isBigEndian())
+            return nullptr;
+
+        auto map = std::make_unique<MemoryMappedFile> (file, MemoryMappedFile::readOnly);
+
+        if (map->getData() == nullptr)
+            return nullptr;
+
+        Array<Entry> entries;
+
+        if (! parseIndex (static_cast<const char*> (map->getData()), (uint64) map->getSize(), entries))
+            return nullptr;
+
+        return new SampleBank (std::move (map), std::move (entries));
+    }
+
+    int getNumEntries() const noexcept                  { return entries.size(); }
+    const Entry& getEntry (int index) const noexcept    { return entries.getReference (index); }
+
+    /** Returns the index of the entry with the given name, or -1. */
+    int indexOf (const String& name) const noexcept
+    {
+        for (int i = 0; i < entries.size(); ++i)
+            if (entries.getReference (i).name == name)
+                return i;
+
+        return -1;
+    }
+
+    /** Creates a buffer that plays one entry from the mapping, and asks the OS to start
+        paging it in. Not for the audio thread.
+    */
+    ReferenceCountedBuffer::Ptr createBuffer (int index)
+    {
+        if (! isPositiveAndBelow (index, entries.size()))
+            return nullptr;
+
+        const auto& entry = entries.getReference (index);
+        const auto* samples = static_cast<const char*> (map->getData()) + entry.dataOffset;
+
+       #if JUCE_LINUX || JUCE_MAC || JUCE_BSD || JUCE_ANDROID
+        ::madvise (const_cast<char*> (samples), (size_t) (getEntryEnd (entry) - entry.dataOffset), MADV_WILLNEED);
+       #endif
+
+        ReferenceCountedBuffer::Ptr buffer = new ReferenceCountedBuffer (entry.name, entry.format, samples, (size_t) entry.channelStride,
+                                                                        entry.numChannels, entry.numSamples, entry.sampleRate, this);
+        buffer->setLoopRegion (entry.loopRegion, entry.crossfadeLength);
+        return buffer;
+    }
+
+    //==============================================================================
+    struct BuildOptions
+    {
+        double sampleRate = 0.0;        // 0 keeps each file at its own rate
+        SampleFormat format = SampleFormat::float32;
+        ResamplingQuality quality = ResamplingQuality::sinc32;
+    };
+
+    /** Decodes the given files (one at a time, so memory use stays at one file's worth) and
+        writes them to a new bank, replacing bankFile only once the whole bank is written.
+    */
+    static Result build (const Array<File>& sourceFiles, const File& bankFile, AudioFormatManager& formatManager,
+                         const BuildOptions& options)
+    {
+        TemporaryFile temporary (bankFile);
+        Array<Entry> entries;
+
+        {
+            FileOutputStream stream (temporary.getFile());
+
+            if (stream.failedToOpen())
+                return Result::fail ("Couldn't create " + temporary.getFile().getFullPathName());
+
+            // the index goes at the front, so leave room for it and fill it in at the end
+            stream.writeRepeatedByte (0, (size_t) (headerSize + (uint64) sourceFiles.size() * entrySize));
+
+            for (const auto& file : sourceFiles)
+            {
+                auto buffer = ReferenceCountedBuffer::createFromFile (formatManager, file);
+
+                if (buffer == nullptr || buffer->getNumSamples() == 0)
+                    return Result::fail ("Couldn't read " + file.getFullPathName());
+
+                if (options.sampleRate > 0.0 && ! approximatelyEqual (buffer->getSampleRate(), options.sampleRate))
+                    buffer = PolyphaseResampler::convertSampleRate (buffer->getName(), *buffer, options.sampleRate, options.quality);
+
+                Entry entry;
+                entry.name = truncateName (buffer->getName());
+                entry.format = options.format;
+                entry.numChannels = buffer->getNumChannels();
+                entry.numSamples = buffer->getNumSamples();
+                entry.loopRegion = buffer->getLoopRegion();
+                entry.crossfadeLength = buffer->getLoopCrossfadeLength();
+                entry.sampleRate = buffer->getSampleRate();
+                entry.channelStride = alignUp ((uint64) entry.numSamples * SampleConversion::getBytesPerSample (entry.format));
+
+                for (int channel = 0; channel < entry.numChannels; ++channel)
+                {
+                    const auto position = (uint64) stream.getPosition();
+                    stream.writeRepeatedByte (0, (size_t) (alignUp (position) - position));
+
+                    if (channel == 0)
+                        entry.dataOffset = (uint64) stream.getPosition();
+
+                    writeChannel (stream, *buffer, channel, entry.format);
+                }
+
+                entries.add (entry);
+            }
+
+            stream.setPosition (0);
+            writeIndex (stream, entries);
+            stream.flush();
+
+            if (stream.getStatus().failed())
+                return stream.getStatus();
+        }
+
+        if (! temporary.overwriteTargetFileWithTemporary())
+            return Result::fail ("Couldn't replace " + bankFile.getFullPathName());
+
+        return Result::ok();
+    }
+
+    /** Handles the --build-bank command:
+
+        --build-bank <output.bank> <file|folder>... [--rate=<hz>] [--format=float32|int16|float16]
+                     [--quality=linear|sinc8|sinc16|sinc32]
+    */
+    static void runBuildCommand (const ArgumentList& args)
+    {
+        args.checkMinNumArguments (3);
+
+        const auto bankFile = args[1].resolveAsFile();
+
+        AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+
+        Array<File> sourceFiles;
+
+        for (int i = 2; i < args.size(); ++i)
+        {
+            if (args[i].isOption())
+                continue;
+
+            const auto file = args[i].resolveAsFile();
+
+            if (file.isDirectory())
+            {
+                auto found = file.findChildFiles (File::findFiles, true, formatManager.getWildcardForAllFormats());
+                found.sort();
+                sourceFiles.addArray (found);
+            }
+            else if (file.existsAsFile())
+            {
+                sourceFiles.add (file);
+            }
+            else
+            {
+                ConsoleApplication::fail ("Couldn't find " + file.getFullPathName());
+            }
+        }
+
+        if (sourceFiles.isEmpty())
+            ConsoleApplication::fail ("No audio files to put in the bank");
+
+        BuildOptions options;
+        options.sampleRate = args.getValueForOption ("--rate").getDoubleValue();
+        options.format = getFormatFromName (args.getValueForOption ("--format"), SampleFormat::float32);
+        options.quality = PolyphaseResampler::getQualityFromName (args.getValueForOption ("--quality"), ResamplingQuality::sinc32);
+
+        const auto buildStart = Time::getHighResolutionTicks();
+        const auto result = build (sourceFiles, bankFile, formatManager, options);
+
+        if (result.failed())
+            ConsoleApplication::fail (result.getErrorMessage());
+
+        const auto buildSeconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - buildStart);
+
+        // what the app pays at start-up instead of the decode
+        const auto openStart = Time::getHighResolutionTicks();
+        auto bank = open (bankFile);
+        const auto openSeconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - openStart);
+
+        if (bank == nullptr)
+            ConsoleApplication::fail ("Couldn't read back " + bankFile.getFullPathName());
+
+        std::cout << "Wrote " << bank->getNumEntries() << " samples (" << String (bankFile.getSize() / (1024.0 * 1024.0), 1)
+                  << " MB) to " << bankFile.getFileName() << " in " << String (buildSeconds, 2) << " s; opening it takes "
+                  << String (openSeconds * 1000.0, 3) << " ms" << std::endl;
+    }
+
+    static constexpr uint64 alignment = 16384;
+
+private:
+    SampleBank (std::unique_ptr<MemoryMappedFile> mapToUse, Array<Entry>&& entriesToUse)
+        : map (std::move (mapToUse)),
+          entries (std::move (entriesToUse))
+    {
+    }
+
+    static constexpr const char* magic = "LOOPBANK";
+    static constexpr uint32 currentVersion = 1;
+    static constexpr uint64 headerSize = 64, entrySize = 128;
+    static constexpr int nameBytes = 64;
+    static constexpr int maxChannels = 64;
+
+    static uint64 alignUp (uint64 position) noexcept
+    {
+        return (position + alignment - 1) & ~(alignment - 1);
+    }
+
+    /** The end of the last channel's samples, relative to the start of the file. */
+    static uint64 getEntryEnd (const Entry& entry) noexcept
+    {
+        return entry.dataOffset + (uint64) (entry.numChannels - 1) * entry.channelStride
+                 + (uint64) entry.numSamples * SampleConversion::getBytesPerSample (entry.format);
+    }
+
+    /** Shortens a name to fit the index, without cutting a character in half. */
+    static String truncateName (String name)
+    {
+        while (name.getNumBytesAsUTF8() >= (size_t) nameBytes)
+            name = name.dropLastCharacters (1);
+
+        return name;
+    }
+
+    static SampleFormat getFormatFromName (const String& name, SampleFormat defaultFormat)
+    {
+        if (name == "float32")  return SampleFormat::float32;
+        if (name == "int16")    return SampleFormat::int16;
+        if (name == "float16")  return SampleFormat::float16;
+
+        return defaultFormat;
+    }
+
+    static void writeChannel (OutputStream& stream, const ReferenceCountedBuffer& buffer, int channel, SampleFormat format)
+    {
+        constexpr int chunkSize = ReferenceCountedBuffer::maxContiguousRead;
+        HeapBlock<float> floats ((size_t) chunkSize);
+        HeapBlock<uint16> compact ((size_t) chunkSize);
+
+        for (int start = 0; start < buffer.getNumSamples(); start += chunkSize)
+        {
+            const auto numThisTime = jmin (chunkSize, buffer.getNumSamples() - start);
+            buffer.read (channel, start, floats, numThisTime);
+
+            switch (format)
+            {
+                case SampleFormat::int16:
+                    SampleConversion::floatToInt16 (reinterpret_cast<int16*> (compact.getData()), floats, numThisTime);
+                    stream.write (compact, (size_t) numThisTime * sizeof (uint16));
+                    break;
+
+                case SampleFormat::float16:
+                    SampleConversion::floatToHalf (compact, floats, numThisTime);
+                    stream.write (compact, (size_t) numThisTime * sizeof (uint16));
+                    break;
+
+                case SampleFormat::float32:
+                default:
+                    stream.write (floats, (size_t) numThisTime * sizeof (float));
+                    break;
+            }
+        }
+    }
+
+    static void writeIndex (OutputStream& stream, const Array<Entry>& entries)
+    {
+        stream.write (magic, 8);
+        stream.writeInt ((int) currentVersion);
+        stream.writeInt ((int) alignment);
+        stream.writeInt (entries.size());
+        stream.writeRepeatedByte (0, (size_t) headerSize - 20);
+
+        for (const auto& entry : entries)
+        {
+            char name[nameBytes] = {};
+            entry.name.copyToUTF8 (name, (size_t) nameBytes);
+            stream.write (name, (size_t) nameBytes);
+
+            stream.writeInt ((int) entry.format);
+            stream.writeInt (entry.numChannels);
+            stream.writeInt (entry.numSamples);
+            stream.writeInt (entry.loopRegion.getStart());
+            stream.writeInt (entry.loopRegion.getEnd());
+            stream.writeInt (entry.crossfadeLength);
+            stream.writeDouble (entry.sampleRate);
+            stream.writeInt64 ((int64) entry.dataOffset);
+            stream.writeInt64 ((int64) entry.channelStride);
+            stream.writeRepeatedByte (0, (size_t) entrySize - nameBytes - 48);
+        }
+    }
+
+    /** Reads and checks the index, making sure every entry's samples lie inside the file. */
+    static bool parseIndex (const char* data, uint64 size, Array<Entry>& entries)
+    {
+        if (size < headerSize || std::memcmp (data, magic, 8) != 0)
+            return false;
+
+        const auto version = ByteOrder::littleEndianInt (data + 8);
+        const auto fileAlignment = (uint64) ByteOrder::littleEndianInt (data + 12);
+        const auto numEntries = (uint64) ByteOrder::littleEndianInt (data + 16);
+
+        if (version != currentVersion || fileAlignment != alignment || headerSize + numEntries * entrySize > size)
+            return false;
+
+        for (uint64 i = 0; i < numEntries; ++i)
+        {
+            const auto* record = data + headerSize + i * entrySize;
+            const auto* fields = record + nameBytes;
+
+            Entry entry;
+            entry.name = String::fromUTF8 (record, (int) strnlen (record, (size_t) nameBytes));
+
+            const auto format = ByteOrder::littleEndianInt (fields);
+            entry.numChannels = (int) ByteOrder::littleEndianInt (fields + 4);
+            entry.numSamples = (int) ByteOrder::littleEndianInt (fields + 8);
+            entry.loopRegion = { (int) ByteOrder::littleEndianInt (fields + 12), (int) ByteOrder::littleEndianInt (fields + 16) };
+            entry.crossfadeLength = (int) ByteOrder::littleEndianInt (fields + 20);
+
+            const auto rateBits = ByteOrder::littleEndianInt64 (fields + 24);
+            std::memcpy (&entry.sampleRate, &rateBits, sizeof (double));
+
+            entry.dataOffset = ByteOrder::littleEndianInt64 (fields + 32);
+            entry.channelStride = ByteOrder::littleEndianInt64 (fields + 40);
+
+            if (format > (uint32) SampleFormat::float16)
+                return false;
+
+            entry.format = (SampleFormat) format;
+
+            const auto bytesPerChannel = (uint64) entry.numSamples * SampleConversion::getBytesPerSample (entry.format);
+
+            // every term is bounded by the file size before it's added, so none of this can overflow
+            if (entry.numChannels <= 0 || entry.numChannels > maxChannels || entry.numSamples <= 0
+                 || entry.loopRegion.getStart() < 0 || entry.loopRegion.getEnd() > entry.numSamples || entry.loopRegion.isEmpty()
+                 || entry.crossfadeLength < 0 || entry.crossfadeLength > entry.loopRegion.getStart()
+                 || ! (entry.sampleRate > 0.0)
+                 || entry.dataOffset % alignment != 0 || entry.channelStride % alignment != 0
+                 || entry.channelStride < bytesPerChannel || entry.channelStride > size || entry.dataOffset > size
+                 || getEntryEnd (entry) > size)
+                return false;
+
+            entries.add (entry);
+        }
+
+        return true;
+    }
+
+    std::unique_ptr<MemoryMappedFile> map;
+    Array<Entry> entries;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleBank)
+};
@@ -0,0 +1,178 @@
+/*
+  ==============================================================================
+
+    SampleCache.h
+    Created: 16 Oct 2026 10:49:09pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ReferenceCountedBuffer.h"
+#include "TraceRecorder.h"
+
+/** A process-wide cache of decoded buffers with a memory budget.
+
+    Buffers are keyed by file path, modification time and the sample rate they were
+    converted to, so re-opening a file that hasn't changed skips the decode. When the
+    cache holds more than its budget, the least recently used buffers that nobody else
+    holds a reference to (i.e. that aren't playing or about to play) are dropped.
+
+    Use it through a SharedResourcePointer<SampleCache> so that every user in the
+    process shares one instance. Never call it from the audio thread: it locks, and
+    evicting a buffer runs its destructor on the calling thread.
+*/
+class SampleCache
+{
+public:
+    struct Statistics
+    {
+        int64 hits = 0, misses = 0, evictions = 0;
+        size_t bytesInUse = 0, memoryBudget = 0;
+        int numBuffers = 0;
+    };
+
+    SampleCache() = default;
+
+    /** Builds the key for a file decoded (and converted to targetSampleRate, or 0 for its own rate)
+        and stored in the given format.
+    */
+    static String makeKey (const File& file, double targetSampleRate, SampleFormat format = SampleFormat::float32)
+    {
+        return file.getFullPathName()
+                 + "|" + String (file.getLastModificationTime().toMilliseconds())
+                 + "|" + String (targetSampleRate)
+                 + "|" + String ((int) format);
+    }
+
+    /** Returns the cached buffer for a key, or nullptr, and counts a hit or a miss. */
+    ReferenceCountedBuffer::Ptr get (const String& key)
+    {
+        const ScopedLock sl (lock);
+
+        for (auto& entry : entries)
+        {
+            if (entry.key == key)
+            {
+                ++stats.hits;
+                entry.lastUsed = ++useCounter;
+                return entry.buffer;
+            }
+        }
+
+        ++stats.misses;
+        return nullptr;
+    }
+
+    /** Adds (or replaces) a buffer and evicts unused ones if that takes the cache over budget. */
+    void add (const String& key, ReferenceCountedBuffer::Ptr buffer)
+    {
+        jassert (buffer != nullptr);
+
+        // declared first, so that the span covers the evicted buffers' destructors
+        TraceRecorder::Span span { *trace, "cache add" };
+        Array<ReferenceCountedBuffer::Ptr> evicted;
+
+        {
+            const ScopedLock sl (lock);
+
+            for (int i = entries.size(); --i >= 0;)
+                if (entries.getReference (i).key == key)
+                    evicted.add (removeEntry (i));
+
+            entries.add (Entry { key, buffer, buffer->getSizeInBytes(), ++useCounter });
+            stats.bytesInUse += buffer->getSizeInBytes();
+
+            evictUnusedBuffers (evicted);
+        }
+
+        span.setValue (evicted.size());
+
+        // the evicted buffers are destroyed here, outside the lock
+    }
+
+    void setMemoryBudget (size_t newBudgetInBytes)
+    {
+        Array<ReferenceCountedBuffer::Ptr> evicted;
+
+        const ScopedLock sl (lock);
+        stats.memoryBudget = newBudgetInBytes;
+        evictUnusedBuffers (evicted);
+    }
+
+    /** Drops every buffer that isn't in use elsewhere. */
+    void clearUnused()
+    {
+        TraceRecorder::Span span { *trace, "cache sweep" };
+        Array<ReferenceCountedBuffer::Ptr> evicted;
+
+        const ScopedLock sl (lock);
+
+        for (int i = entries.size(); --i >= 0;)
+            if (entries.getReference (i).buffer->getReferenceCount() == 1)
+                evicted.add (removeEntry (i));
+
+        span.setValue (evicted.size());
+    }
+
+    Statistics getStatistics() const
+    {
+        const ScopedLock sl (lock);
+
+        auto result = stats;
+        result.numBuffers = entries.size();
+        return result;
+    }
+
+private:
+    struct Entry
+    {
+        String key;
+        ReferenceCountedBuffer::Ptr buffer;
+        size_t bytes;
+        uint64 lastUsed;
+    };
+
+    ReferenceCountedBuffer::Ptr removeEntry (int index)
+    {
+        auto buffer = entries.getReference (index).buffer;
+        stats.bytesInUse -= entries.getReference (index).bytes;
+        entries.remove (index);
+        return buffer;
+    }
+
+    void evictUnusedBuffers (Array<ReferenceCountedBuffer::Ptr>& evicted)
+    {
+        while (stats.bytesInUse > stats.memoryBudget)
+        {
+            int oldestUnused = -1;
+
+            for (int i = 0; i < entries.size(); ++i)
+            {
+                const auto& entry = entries.getReference (i);
+
+                // only the cache refers to it, so nobody is playing it
+                if (entry.buffer->getReferenceCount() == 1
+                     && (oldestUnused < 0 || entry.lastUsed < entries.getReference (oldestUnused).lastUsed))
+                    oldestUnused = i;
+            }
+
+            if (oldestUnused < 0)
+                break;
+
+            evicted.add (removeEntry (oldestUnused));
+            ++stats.evictions;
+        }
+    }
+
+    SharedResourcePointer<TraceRecorder> trace;
+
+    CriticalSection lock;
+    Array<Entry> entries;
+    Statistics stats { 0, 0, 0, 0, (size_t) 512 * 1024 * 1024, 0 };
+    uint64 useCounter = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleCache)
+};
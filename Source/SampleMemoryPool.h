@@ -0,0 +1,361 @@
+/*
+  ==============================================================================
+
+    SampleMemoryPool.h
+    Created: 16 Oct 2026 11:29:32pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_LINUX || JUCE_MAC || JUCE_BSD || JUCE_ANDROID
+ #include <sys/mman.h>
+#endif
+
+/** Where ReferenceCountedBuffer gets the memory for its samples.
+
+    Sample memory is handed out in size classes: sizes are rounded up to a quarter of
+    the power of two below them, so no more than 25% is wasted. From 8 MB up, those
+    quarters are themselves whole 2 MB huge pages. A block that's given back isn't
+    freed. It's kept for the next buffer of the same class, up to a retained budget,
+    beyond which the least recently used blocks are returned to the system. A player
+    that keeps swapping between samples of similar lengths ends up reusing the same few
+    blocks. Their pages are already faulted in, and the heap never fragments.
+
+    Fresh blocks come straight from the OS (mmap where there is one). On Linux large
+    blocks are aligned to and advised as transparent huge pages, which cuts TLB misses
+    when voices read all over a long sample. Fresh blocks are pre-faulted on the loading
+    thread, so the audio thread never takes a page fault on first touch. reserve() fills
+    the pool ahead of time, e.g. at startup.
+
+    Use it through a SharedResourcePointer<SampleMemoryPool>. Never allocate from the
+    audio thread: it locks, and may map memory. Blocks can be released on any thread
+    that's allowed to lock, such as the ReleasePool's.
+*/
+class SampleMemoryPool
+{
+public:
+    struct Options
+    {
+        bool useHugePages = true;       // Linux only: advise blocks of 2 MB and up as transparent huge pages
+        bool prefault = true;           // touch every page of a fresh block before handing it out
+        size_t retainedBudget = (size_t) 256 * 1024 * 1024;    // how much freed memory to keep for reuse
+    };
+
+    struct Statistics
+    {
+        size_t bytesInUse = 0, bytesRetained = 0, peakBytesInUse = 0;
+        int numBlocksInUse = 0, numBlocksRetained = 0;
+        int64 allocations = 0, reuses = 0, systemAllocations = 0, systemReleases = 0;
+    };
+
+    //==============================================================================
+    /** A block of sample memory, 64-byte aligned, that goes back to the pool when it's deleted. */
+    class Block
+    {
+    public:
+        Block() = default;
+        ~Block()                                    { reset(); }
+
+        Block (Block&& other) noexcept
+            : pool (std::exchange (other.pool, nullptr)),
+              data (std::exchange (other.data, nullptr)),
+              size (std::exchange (other.size, 0))
+        {
+        }
+
+        Block& operator= (Block&& other) noexcept
+        {
+            reset();
+            pool = std::exchange (other.pool, nullptr);
+            data = std::exchange (other.data, nullptr);
+            size = std::exchange (other.size, 0);
+            return *this;
+        }
+
+        void* getData() const noexcept              { return data; }
+
+        /** The size of the block's class, which may be more than was asked for. */
+        size_t getSize() const noexcept             { return size; }
+
+        void reset()
+        {
+            if (pool != nullptr)
+                pool->release (std::exchange (data, nullptr), std::exchange (size, 0));
+
+            pool = nullptr;
+        }
+
+    private:
+        friend class SampleMemoryPool;
+
+        Block (SampleMemoryPool& owner, void* blockData, size_t blockSize) noexcept
+            : pool (&owner), data (blockData), size (blockSize)
+        {
+        }
+
+        SampleMemoryPool* pool = nullptr;
+        void* data = nullptr;
+        size_t size = 0;
+
+        JUCE_DECLARE_NON_COPYABLE (Block)
+    };
+
+    //==============================================================================
+    SampleMemoryPool() = default;
+
+    ~SampleMemoryPool()
+    {
+        // every Block has to go before the pool; ReferenceCountedBuffer holds the pool to make sure
+        jassert (stats.numBlocksInUse == 0);
+
+        for (auto& block : retained)
+            unmapMemory (block.data, block.size);
+    }
+
+    /** Returns a block of at least numBytes, reusing one of the same class if there's one
+        spare. The contents are undefined. Returns an empty block for 0 bytes or if the
+        system is out of memory.
+    */
+    Block allocate (size_t numBytes)
+    {
+        if (numBytes == 0)
+            return {};
+
+        const auto size = getSizeClass (numBytes);
+
+        {
+            const ScopedLock sl (lock);
+            ++stats.allocations;
+
+            // the most recently freed block of the class is the likeliest to still be in the cache
+            for (int i = retained.size(); --i >= 0;)
+            {
+                if (retained.getReference (i).size == size)
+                {
+                    auto* data = retained.getReference (i).data;
+                    retained.remove (i);
+                    stats.bytesRetained -= size;
+                    --stats.numBlocksRetained;
+                    ++stats.reuses;
+                    addInUse (size);
+                    return { *this, data, size };
+                }
+            }
+        }
+
+        // mapping and faulting in a large block takes a while, so it happens outside the lock
+        const auto currentOptions = getOptions();
+        auto* data = mapMemory (size, currentOptions);
+
+        if (data == nullptr)
+            return {};
+
+        const ScopedLock sl (lock);
+        ++stats.systemAllocations;
+        addInUse (size);
+        return { *this, data, size };
+    }
+
+    /** Makes sure there are at least numBlocks spare blocks of the class numBytes falls in
+        (budget permitting), mapping and pre-faulting any that are missing now rather than
+        when a sample is loaded.
+    */
+    void reserve (size_t numBytes, int numBlocks)
+    {
+        std::vector<Block> blocks;
+
+        for (int i = 0; i < numBlocks; ++i)
+            blocks.push_back (allocate (numBytes));
+
+        // going back out of scope puts them all in the pool
+    }
+
+    void setOptions (const Options& newOptions)
+    {
+        Array<RetainedBlock> trimmed;
+
+        {
+            const ScopedLock sl (lock);
+            options = newOptions;
+            trimRetained (trimmed);
+        }
+
+        for (auto& block : trimmed)
+            unmapMemory (block.data, block.size);
+    }
+
+    Options getOptions() const
+    {
+        const ScopedLock sl (lock);
+        return options;
+    }
+
+    /** Returns every spare block to the system. */
+    void releaseRetained()
+    {
+        Array<RetainedBlock> trimmed;
+
+        {
+            const ScopedLock sl (lock);
+            trimmed.swapWith (retained);
+            stats.systemReleases += trimmed.size();
+            stats.bytesRetained = 0;
+            stats.numBlocksRetained = 0;
+        }
+
+        for (auto& block : trimmed)
+            unmapMemory (block.data, block.size);
+    }
+
+    Statistics getStatistics() const
+    {
+        const ScopedLock sl (lock);
+        return stats;
+    }
+
+    /** The size a request for numBytes is rounded up to. */
+    static size_t getSizeClass (size_t numBytes) noexcept
+    {
+        auto size = jmax (numBytes, minBlockSize);
+
+        auto powerOfTwo = minBlockSize;
+
+        while (powerOfTwo * 2 <= size)
+            powerOfTwo *= 2;
+
+        // from 8 MB up the step is a multiple of the huge page size, so those classes fill
+        // their huge pages; rounding smaller ones up to whole pages could waste far more than 25%
+        const auto step = powerOfTwo / 4;
+        return (size + step - 1) / step * step;
+    }
+
+    static constexpr size_t minBlockSize = 64 * 1024;
+    static constexpr size_t hugePageSize = 2 * 1024 * 1024;
+
+private:
+    struct RetainedBlock
+    {
+        void* data;
+        size_t size;
+    };
+
+    void addInUse (size_t size) noexcept
+    {
+        stats.bytesInUse += size;
+        stats.peakBytesInUse = jmax (stats.peakBytesInUse, stats.bytesInUse);
+        ++stats.numBlocksInUse;
+    }
+
+    void release (void* data, size_t size)
+    {
+        Array<RetainedBlock> trimmed;
+
+        {
+            const ScopedLock sl (lock);
+            stats.bytesInUse -= size;
+            --stats.numBlocksInUse;
+
+            retained.add ({ data, size });
+            stats.bytesRetained += size;
+            ++stats.numBlocksRetained;
+
+            trimRetained (trimmed);
+        }
+
+        for (auto& block : trimmed)
+            unmapMemory (block.data, block.size);
+    }
+
+    /** Takes the oldest spare blocks out until the rest fit in the budget. Called with the lock held. */
+    void trimRetained (Array<RetainedBlock>& trimmed)
+    {
+        while (stats.bytesRetained > options.retainedBudget && ! retained.isEmpty())
+        {
+            const auto oldest = retained.removeAndReturn (0);
+            stats.bytesRetained -= oldest.size;
+            --stats.numBlocksRetained;
+            ++stats.systemReleases;
+            trimmed.add (oldest);
+        }
+    }
+
+    //==============================================================================
+    static void* mapMemory (size_t size, const Options& mapOptions)
+    {
+        void* data = nullptr;
+
+       #if JUCE_LINUX || JUCE_MAC || JUCE_BSD || JUCE_ANDROID
+       #if JUCE_LINUX || JUCE_ANDROID
+        const auto wantsHugePages = mapOptions.useHugePages && size >= hugePageSize;
+       #else
+        const auto wantsHugePages = false;
+       #endif
+
+        // huge pages need 2 MB alignment, so map a little extra and trim it off both ends
+        const auto mappedSize = wantsHugePages ? size + hugePageSize : size;
+        auto* mapped = ::mmap (nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+
+        if (mapped == MAP_FAILED)
+            return nullptr;
+
+        data = mapped;
+
+        if (wantsHugePages)
+        {
+            const auto address = reinterpret_cast<pointer_sized_uint> (mapped);
+            const auto aligned = (address + hugePageSize - 1) & ~(pointer_sized_uint) (hugePageSize - 1);
+
+            if (aligned > address)
+                ::munmap (mapped, aligned - address);
+
+            if (aligned + size < address + mappedSize)
+                ::munmap (reinterpret_cast<void*> (aligned + size), address + mappedSize - (aligned + size));
+
+            data = reinterpret_cast<void*> (aligned);
+
+           #ifdef MADV_HUGEPAGE
+            ::madvise (data, size, MADV_HUGEPAGE);
+           #endif
+        }
+       #else
+        ignoreUnused (mapOptions);
+        data = ::operator new (size, std::align_val_t (64), std::nothrow);
+
+        if (data == nullptr)
+            return nullptr;
+       #endif
+
+        if (mapOptions.prefault)
+        {
+            // writing one byte per page makes the OS back the whole block now, on this thread
+            auto* bytes = static_cast<volatile char*> (data);
+
+            for (size_t offset = 0; offset < size; offset += 4096)
+                bytes[offset] = 0;
+        }
+
+        return data;
+    }
+
+    static void unmapMemory (void* data, size_t size)
+    {
+       #if JUCE_LINUX || JUCE_MAC || JUCE_BSD || JUCE_ANDROID
+        ::munmap (data, size);
+       #else
+        ignoreUnused (size);
+        ::operator delete (data, std::align_val_t (64));
+       #endif
+    }
+
+    CriticalSection lock;
+    Options options;
+    Array<RetainedBlock> retained;      // oldest first
+    Statistics stats;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleMemoryPool)
+};
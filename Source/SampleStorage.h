@@ -0,0 +1,201 @@
+/*
+  ==============================================================================
+
+    SampleStorage.h
+    Created: 16 Oct 2026 10:56:00pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "MixKernels.h"
+
+#if LOOPER_MIX_AVX && defined (__F16C__)
+ #define LOOPER_STORAGE_F16C 1
+#endif
+
+#if LOOPER_MIX_NEON && (defined (__aarch64__) || defined (_M_ARM64))
+ #define LOOPER_STORAGE_NEON_FP16 1
+#endif
+
+/** How a ReferenceCountedBuffer keeps its samples in memory. */
+enum class SampleFormat
+{
+    float32,    // 4 bytes per sample, read with no conversion at all
+    int16,      // 2 bytes per sample; exact for 16-bit sources, whose decoded floats are all n / 32768
+    float16     // 2 bytes per sample, IEEE half precision: about 11 bits of mantissa at any level
+};
+
+//==============================================================================
+/** Conversions between float and the compact sample formats.
+
+    The decoding direction runs on the audio thread every time a compact buffer is read,
+    so it's vectorised; the encoding direction only runs while a buffer is being loaded.
+*/
+namespace SampleConversion
+{
+    inline size_t getBytesPerSample (SampleFormat format) noexcept
+    {
+        return format == SampleFormat::float32 ? sizeof (float) : sizeof (uint16);
+    }
+
+    //==============================================================================
+    /** dest[i] = src[i] / 32768, which gives back exactly what the decoder produced for a 16-bit file. */
+    inline void int16ToFloat (float* dest, const int16* src, int numSamples) noexcept
+    {
+        constexpr auto scale = 1.0f / 32768.0f;
+        int i = 0;
+
+       #if LOOPER_MIX_AVX && defined (__AVX2__)
+        const auto scale8 = _mm256_set1_ps (scale);
+
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            const auto widened = _mm256_cvtepi16_epi32 (_mm_loadu_si128 (reinterpret_cast<const __m128i*> (src + i)));
+            _mm256_storeu_ps (dest + i, _mm256_mul_ps (_mm256_cvtepi32_ps (widened), scale8));
+        }
+       #elif LOOPER_MIX_AVX || LOOPER_MIX_SSE
+        const auto scale4 = _mm_set1_ps (scale);
+
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            const auto packed = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (src + i));
+
+            // interleaving with itself and shifting right arithmetically sign-extends each half
+            const auto low  = _mm_srai_epi32 (_mm_unpacklo_epi16 (packed, packed), 16);
+            const auto high = _mm_srai_epi32 (_mm_unpackhi_epi16 (packed, packed), 16);
+
+            _mm_storeu_ps (dest + i,     _mm_mul_ps (_mm_cvtepi32_ps (low),  scale4));
+            _mm_storeu_ps (dest + i + 4, _mm_mul_ps (_mm_cvtepi32_ps (high), scale4));
+        }
+       #elif LOOPER_MIX_NEON
+        const auto scale4 = vdupq_n_f32 (scale);
+
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            const auto packed = vld1q_s16 (src + i);
+
+            vst1q_f32 (dest + i,     vmulq_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (packed))),  scale4));
+            vst1q_f32 (dest + i + 4, vmulq_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (packed))), scale4));
+        }
+       #endif
+
+        for (; i < numSamples; ++i)
+            dest[i] = (float) src[i] * scale;
+    }
+
+    /** Rounds to the nearest 16-bit value, clipping anything outside [-1, 1). */
+    inline void floatToInt16 (int16* dest, const float* src, int numSamples) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] = (int16) jlimit (-32768, 32767, roundToInt (src[i] * 32768.0f));
+    }
+
+    //==============================================================================
+    namespace detail
+    {
+        inline float halfToFloat (uint16 half) noexcept
+        {
+            const auto sign = (uint32) (half & 0x8000u) << 16;
+            auto exponent = (uint32) (half >> 10) & 0x1fu;
+            auto mantissa = (uint32) half & 0x3ffu;
+            uint32 bits;
+
+            if (exponent == 0x1fu)
+            {
+                bits = sign | 0x7f800000u | (mantissa << 13);                  // inf or NaN
+            }
+            else if (exponent != 0)
+            {
+                bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);    // normal
+            }
+            else if (mantissa == 0)
+            {
+                bits = sign;                                                    // zero
+            }
+            else
+            {
+                // subnormal: shift the mantissa up until it's normalised
+                exponent = 113u;
+
+                while ((mantissa & 0x400u) == 0)
+                {
+                    mantissa <<= 1;
+                    --exponent;
+                }
+
+                bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+            }
+
+            float result;
+            std::memcpy (&result, &bits, sizeof (result));
+            return result;
+        }
+
+        /** Round-to-nearest-even, like the hardware conversions. */
+        inline uint16 floatToHalf (float value) noexcept
+        {
+            uint32 bits;
+            std::memcpy (&bits, &value, sizeof (bits));
+
+            const auto sign = (uint16) ((bits >> 16) & 0x8000u);
+            const auto absBits = bits & 0x7fffffffu;
+
+            if (absBits >= 0x7f800000u)                                         // inf or NaN
+                return (uint16) (sign | 0x7c00u | (absBits > 0x7f800000u ? 0x200u : 0u));
+
+            if (absBits >= 0x477ff000u)                                         // rounds up past the largest half
+                return (uint16) (sign | 0x7c00u);
+
+            if (absBits < 0x38800000u)                                          // subnormal or zero as a half
+            {
+                if (absBits < 0x33000000u)
+                    return sign;
+
+                const auto shift = 126u - (absBits >> 23);
+                const auto mantissa = (absBits & 0x7fffffu) | 0x800000u;
+                auto result = mantissa >> shift;
+                const auto remainder = mantissa & ((1u << shift) - 1u);
+                const auto halfway = 1u << (shift - 1u);
+
+                if (remainder > halfway || (remainder == halfway && (result & 1u) != 0))
+                    ++result;
+
+                return (uint16) (sign | result);
+            }
+
+            auto result = ((absBits - 0x38000000u) >> 13);
+            const auto remainder = absBits & 0x1fffu;
+
+            if (remainder > 0x1000u || (remainder == 0x1000u && (result & 1u) != 0))
+                ++result;
+
+            return (uint16) (sign | result);
+        }
+    }
+
+    /** Expands IEEE half-precision samples to float. */
+    inline void halfToFloat (float* dest, const uint16* src, int numSamples) noexcept
+    {
+        int i = 0;
+
+       #if LOOPER_STORAGE_F16C
+        for (; i + 8 <= numSamples; i += 8)
+            _mm256_storeu_ps (dest + i, _mm256_cvtph_ps (_mm_loadu_si128 (reinterpret_cast<const __m128i*> (src + i))));
+       #elif LOOPER_STORAGE_NEON_FP16
+        for (; i + 4 <= numSamples; i += 4)
+            vst1q_f32 (dest + i, vcvt_f32_f16 (vreinterpret_f16_u16 (vld1_u16 (src + i))));
+       #endif
+
+        for (; i < numSamples; ++i)
+            dest[i] = detail::halfToFloat (src[i]);
+    }
+
+    inline void floatToHalf (uint16* dest, const float* src, int numSamples) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] = detail::floatToHalf (src[i]);
+    }
+}
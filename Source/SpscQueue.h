@@ -0,0 +1,82 @@
+/*
+  ==============================================================================
+
+    SpscQueue.h
+    Created: 16 Oct 2026 11:20:10pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/** A fixed-size queue between exactly one producer thread and one consumer thread that
+    never locks or allocates, so either end can be the audio thread.
+
+    The consumer can look at the item at the front with peek() before deciding to pop()
+    it, which lets it leave an item in the queue until it's due.
+*/
+template <typename Item, int capacity>
+class SpscQueue
+{
+public:
+    SpscQueue() = default;
+
+    /** Producer only. Returns false, leaving the queue as it was, if it's full. */
+    bool push (const Item& item) noexcept
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        if (size1 + size2 == 0)
+            return false;
+
+        items[(size_t) (size1 > 0 ? start1 : start2)] = item;
+        fifo.finishedWrite (1);
+        return true;
+    }
+
+    /** Consumer only. The item at the front, or nullptr if the queue is empty. */
+    Item* peek() noexcept
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead (1, start1, size1, start2, size2);
+
+        if (size1 + size2 == 0)
+            return nullptr;
+
+        return &items[(size_t) (size1 > 0 ? start1 : start2)];
+    }
+
+    /** Consumer only. Removes the item at the front, which must exist. */
+    void pop() noexcept
+    {
+        jassert (fifo.getNumReady() > 0);
+        fifo.finishedRead (1);
+    }
+
+    /** Consumer only. Moves the front item into result, or returns false if the queue is empty. */
+    bool pop (Item& result) noexcept
+    {
+        if (auto* front = peek())
+        {
+            result = *front;
+            pop();
+            return true;
+        }
+
+        return false;
+    }
+
+    /** The most items the queue can hold at once. */
+    static constexpr int getCapacity() noexcept     { return capacity - 1; }
+
+private:
+    // an AbstractFifo keeps one slot empty to tell full from empty
+    AbstractFifo fifo { capacity };
+    std::array<Item, (size_t) capacity> items {};
+
+    JUCE_DECLARE_NON_COPYABLE (SpscQueue)
+};
@@ -0,0 +1,253 @@
+/*
+  ==============================================================================
+
+    StreamingLoopSource.h
+    Created: 16 Oct 2026 10:42:36pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ChannelRouting.h"
+#include "PolyphaseResampler.h"
+
+/** Loops a file from disk while keeping only a fixed read-ahead window in memory.
+
+    A TimeSliceThread keeps the window topped up from the AudioFormatReader. The read
+    position wraps back to the start of the file on that thread, so the audio thread just
+    consumes a continuous stream and never sees the loop point. If the disk can't keep up,
+    the missing samples are output as silence and counted as an underrun.
+
+    A file at another sample rate than the output's is converted on that thread too, as it's
+    read ahead, so the window always holds samples at the output's rate.
+*/
+class StreamingLoopSource  : public ReferenceCountedObject,
+                             private TimeSliceClient
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<StreamingLoopSource>;
+
+    StreamingLoopSource (const String& nameToUse,
+                         std::unique_ptr<AudioFormatReader> readerToUse,
+                         TimeSliceThread& threadToUse,
+                         int windowSizeInSamples,
+                         double speedRatioToUse = 1.0)
+        : name (nameToUse),
+          reader (std::move (readerToUse)),
+          thread (threadToUse),
+          lengthInSamples (reader->lengthInSamples),
+          speedRatio (speedRatioToUse),
+          window ((int) reader->numChannels, windowSizeInSamples),
+          fifo (windowSizeInSamples)
+    {
+        jassert (lengthInSamples > 0 && speedRatio > 0.0);
+
+        if (isConverting())
+        {
+            // only processSpan() is used, which needs no scratch space
+            resampler.prepareForFixedSpeed (0, speedRatio);
+
+            // the kernel's first outputs reach back before the start of the file, into silence
+            numStaged = PolyphaseResampler::getNumTaps (conversionQuality) / 2 - 1;
+            stagedPosition = numStaged;
+            staging.setSize (window.getNumChannels(),
+                             (int) std::ceil (maximumReadSize * speedRatio) + PolyphaseResampler::getNumTaps (conversionQuality) + 4);
+            staging.clear();
+        }
+
+        // fill the whole window before going live, so playback starts without an underrun
+        while (fifo.getFreeSpace() > 0)
+            readIntoWindow (fifo.getFreeSpace());
+
+        thread.addTimeSliceClient (this);
+
+        DBG ("Created stream: " << name);
+    }
+
+    ~StreamingLoopSource() override
+    {
+        thread.removeTimeSliceClient (this);
+
+        DBG ("Deleted stream: " << name);
+    }
+
+    /** Called on the audio thread. Never locks, allocates or touches the reader. The file's
+        channels are mixed into the output with ChannelRouting::createDefault().
+    */
+    void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) noexcept
+    {
+        auto& output = *bufferToFill.buffer;
+
+        if (! routing.hasShape (window.getNumChannels(), output.getNumChannels()))
+            routing = ChannelRouting::createDefault (window.getNumChannels(), output.getNumChannels());
+
+        for (auto channel = routing.getNumOutputs(); channel < output.getNumChannels(); ++channel)
+            output.clear (channel, bufferToFill.startSample, bufferToFill.numSamples);
+
+        int start1, size1, start2, size2;
+        fifo.prepareToRead (bufferToFill.numSamples, start1, size1, start2, size2);
+
+        if (size1 > 0)
+            routeFromWindow (output, bufferToFill.startSample, start1, size1);
+
+        if (size2 > 0)
+            routeFromWindow (output, bufferToFill.startSample + size1, start2, size2);
+
+        fifo.finishedRead (size1 + size2);
+
+        auto samplesMissing = bufferToFill.numSamples - (size1 + size2);
+
+        if (samplesMissing > 0)
+        {
+            bufferToFill.buffer->clear (bufferToFill.startSample + size1 + size2, samplesMissing);
+            underruns.fetch_add (1, std::memory_order_relaxed);
+        }
+    }
+
+    /** The number of audio callbacks that couldn't be filled completely from the window. */
+    int getNumUnderruns() const noexcept        { return underruns.load (std::memory_order_relaxed); }
+
+    /** The memory held for samples, which stays the same however long the file is. */
+    size_t getWindowSizeInBytes() const noexcept
+    {
+        return ((size_t) window.getNumChannels() * (size_t) window.getNumSamples()
+                  + (size_t) staging.getNumChannels() * (size_t) staging.getNumSamples()) * sizeof (float);
+    }
+
+    const String& getName() const noexcept      { return name; }
+
+private:
+    void routeFromWindow (AudioBuffer<float>& output, int outputStart, int windowStart, int numSamples) noexcept
+    {
+        const float* inputs[ChannelRouting::maxInputs];
+        float* outputs[ChannelRouting::maxOutputs];
+
+        for (auto channel = 0; channel < routing.getNumInputs(); ++channel)
+            inputs[channel] = window.getReadPointer (channel, windowStart);
+
+        for (auto channel = 0; channel < routing.getNumOutputs(); ++channel)
+            outputs[channel] = output.getWritePointer (channel, outputStart);
+
+        routing.process (inputs, outputs, numSamples, 1.0f, 0.0f, false);
+    }
+
+    int useTimeSlice() override
+    {
+        auto freeSpace = fifo.getFreeSpace();
+
+        if (freeSpace < minimumReadSize)
+            return 5;
+
+        readIntoWindow (jmin (freeSpace, maximumReadSize));
+
+        return fifo.getFreeSpace() >= minimumReadSize ? 0 : 5;
+    }
+
+    void readIntoWindow (int numSamples)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite (numSamples, start1, size1, start2, size2);
+
+        readLooping (start1, size1);
+        readLooping (start2, size2);
+
+        fifo.finishedWrite (size1 + size2);
+    }
+
+    bool isConverting() const noexcept      { return ! approximatelyEqual (speedRatio, 1.0); }
+
+    void readLooping (int startInWindow, int numSamples)
+    {
+        if (! isConverting())
+        {
+            readFromFile (window, startInWindow, numSamples);
+            return;
+        }
+
+        const auto numChannels = jmin (window.getNumChannels(), PolyphaseResampler::maxChannels);
+        const auto halfTaps = PolyphaseResampler::getNumTaps (conversionQuality) / 2;
+
+        while (numSamples > 0)
+        {
+            const auto numThisTime = jmin (numSamples, maximumReadSize);
+
+            // read as far into the file as the kernel reaches for this many output samples
+            const auto numNeeded = (int) std::floor (stagedPosition + (numThisTime - 1) * speedRatio) + halfTaps + 2;
+
+            if (numNeeded > numStaged)
+            {
+                readFromFile (staging, numStaged, numNeeded - numStaged);
+                numStaged = numNeeded;
+            }
+
+            const float* sources[PolyphaseResampler::maxChannels];
+            float* dests[PolyphaseResampler::maxChannels];
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                sources[channel] = staging.getReadPointer (channel);
+                dests[channel] = window.getWritePointer (channel, startInWindow);
+            }
+
+            resampler.processSpan (sources, numChannels, stagedPosition, speedRatio, conversionQuality, dests, numThisTime);
+
+            // keep only the samples that the next output samples' kernels still reach back to
+            const auto numUsed = jlimit (0, numStaged, (int) std::floor (stagedPosition) - (halfTaps - 1));
+
+            for (int channel = 0; channel < staging.getNumChannels(); ++channel)
+                std::memmove (staging.getWritePointer (channel), staging.getReadPointer (channel, numUsed),
+                              (size_t) (numStaged - numUsed) * sizeof (float));
+
+            numStaged -= numUsed;
+            stagedPosition -= numUsed;
+            startInWindow += numThisTime;
+            numSamples -= numThisTime;
+        }
+    }
+
+    /** Reads the file into a buffer, wrapping back to its start at the end. */
+    void readFromFile (AudioBuffer<float>& dest, int startInDest, int numSamples)
+    {
+        while (numSamples > 0)
+        {
+            auto samplesThisTime = (int) jmin ((int64) numSamples, lengthInSamples - readPosition);
+
+            reader->read (&dest, startInDest, samplesThisTime, readPosition, true, true);
+
+            startInDest += samplesThisTime;
+            numSamples -= samplesThisTime;
+            readPosition += samplesThisTime;
+
+            if (readPosition == lengthInSamples)
+                readPosition = 0;
+        }
+    }
+
+    static constexpr int minimumReadSize = 2048;
+    static constexpr int maximumReadSize = 32768;
+
+    // converting rates here is off the audio thread, so it can afford the best kernel
+    static constexpr auto conversionQuality = ResamplingQuality::sinc32;
+
+    const String name;
+    std::unique_ptr<AudioFormatReader> reader;
+    TimeSliceThread& thread;
+
+    const int64 lengthInSamples;
+    int64 readPosition = 0;
+
+    const double speedRatio;            // the file's sample rate over the output's
+    PolyphaseResampler resampler;
+    AudioBuffer<float> staging;         // file samples waiting to be converted
+    int numStaged = 0;
+    double stagedPosition = 0.0;        // where in staging the next output sample is centred
+
+    AudioBuffer<float> window;
+    AbstractFifo fifo;
+    std::atomic<int> underruns { 0 };
+    ChannelRouting routing;     // only touched by the audio thread
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StreamingLoopSource)
+};
@@ -0,0 +1,528 @@
+/*
+  ==============================================================================
+
+    StressTest.h
+    Created: 16 Oct 2026 11:37:33pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "LooperEngine.h"
+
+/** Runs the app's loading, clearing and playback paths against each other from several
+    threads at once, while a simulated audio thread renders blocks flat out, and fails if
+    anything goes wrong or gets slower.
+
+    The Rig drives the same LooperEngine as the app's MainContentComponent, and each thread
+    does what one of the app's does:
+
+    - loader: picks fixtures to play or preload, which takes in the cache, memory-mapping,
+      progressive and whole-file decodes, sample rate conversion, and streaming for the
+      long fixture.
+    - clearer: clearButtonClicked(), i.e. cancels every load, publishes nothing and stops
+      every voice.
+    - voices: addVoiceButtonClicked(), plus retuning and stopping voices at random.
+    - sweeper: everything timerCallback() reads, plus dropping the cache's unused buffers.
+    - the audio thread (the calling thread): getNextAudioBlock(), with the device stopped
+      and restarted every so often through releaseResources() and prepareToPlay() at a
+      different block size, rate and channel count.
+
+    Freed sample memory goes straight back to the system rather than being kept for reuse,
+    so a buffer that's read after its release faults at once instead of quietly playing
+    somebody else's samples. Finding the races is left to ThreadSanitizer: build the console
+    app with e.g. CXXFLAGS="-fsanitize=thread" (or "-fsanitize=address,undefined") with the
+    Linux makefile and run --stress. In a build with LOOPER_REALTIME_CHECKS, the audio
+    thread doing anything it mustn't fails the run too.
+
+    Every block is timed. The run reports the block time percentiles and each thread's
+    throughput as JSON, and given the JSON of an earlier run on the same machine with
+    --baseline, fails if the tail got longer or the audio thread got slower by more than
+    --tolerance percent. With --trace, the end of the run is also saved as a Chrome trace,
+    to see what each thread was doing around the slowest blocks.
+*/
+class StressTest
+{
+public:
+    /** Handles the --stress command:
+
+        --stress [--blocks=<n>] [--seed=<n>] [--output=<file.json>] [--trace=<file.json>]
+                 [--baseline=<file.json>] [--tolerance=<percent>] [--quick]
+    */
+    static void run (const ArgumentList& args)
+    {
+        const auto numBlocks = (int64) getOption (args, "--blocks", args.containsOption ("--quick") ? 100000 : 2000000);
+        const auto seed = (int64) getOption (args, "--seed", 1);
+        const auto tolerance = getOption (args, "--tolerance", 25.0) / 100.0;
+
+        if (numBlocks <= 0)
+            ConsoleApplication::fail ("--blocks needs to be at least 1");
+
+        // read the baseline first, so a bad path fails before the run rather than after it
+        var baseline;
+        const auto baselineFile = args.getValueForOption ("--baseline");
+
+        if (baselineFile.isNotEmpty())
+        {
+            baseline = JSON::parse (File::getCurrentWorkingDirectory().getChildFile (baselineFile));
+
+            if (! baseline.isObject())
+                ConsoleApplication::fail ("Couldn't read the baseline from " + baselineFile);
+        }
+
+        SharedResourcePointer<SampleMemoryPool> sampleMemory;
+        auto memoryOptions = sampleMemory->getOptions();
+        memoryOptions.retainedBudget = 0;
+        sampleMemory->setOptions (memoryOptions);
+
+        const auto fixtures = File::getSpecialLocation (File::tempDirectory).getNonexistentChildFile ("LooperStressTest", {});
+
+        if (! writeFixtures (fixtures))
+        {
+            fixtures.deleteRecursively();
+            ConsoleApplication::fail ("Couldn't write the fixtures to " + fixtures.getFullPathName());
+        }
+
+        // held here so that the trace outlives the rig, and shows its teardown too
+        SharedResourcePointer<TraceRecorder> trace;
+        Result result;
+
+        {
+            Rig rig (fixtures);
+            result = rig.run (numBlocks, seed);
+        }
+
+        fixtures.deleteRecursively();
+
+        const auto traceFile = args.getValueForOption ("--trace");
+
+        if (traceFile.isNotEmpty() && ! trace->writeChromeJson (File::getCurrentWorkingDirectory().getChildFile (traceFile)))
+            ConsoleApplication::fail ("Couldn't write " + traceFile);
+
+        // with the rig gone, nothing should still be holding on to sample memory
+        const auto leakedBlocks = sampleMemory->getStatistics().numBlocksInUse;
+
+        auto json = result.toJson();
+        json.getDynamicObject()->setProperty ("seed", seed);
+
+        const auto outputFile = args.getValueForOption ("--output");
+
+        if (outputFile.isEmpty())
+            std::cout << JSON::toString (json) << std::endl;
+        else if (! File::getCurrentWorkingDirectory().getChildFile (outputFile).replaceWithText (JSON::toString (json)))
+            ConsoleApplication::fail ("Couldn't write " + outputFile);
+
+        StringArray failures;
+
+        if (const auto numViolations = RealtimeChecker::getNumViolations())
+            failures.add (String ((int64) numViolations) + " real-time violations on the audio thread");
+
+        if (result.numBadBlocks > 0)
+            failures.add (String (result.numBadBlocks) + " blocks with samples that were NaN, infinite or far too loud");
+
+        if (leakedBlocks > 0)
+            failures.add (String (leakedBlocks) + " blocks of sample memory still in use after the rig was destroyed");
+
+        if (baseline.isObject())
+            failures.addArray (compareWithBaseline (json, baseline, tolerance));
+
+        if (! failures.isEmpty())
+            ConsoleApplication::fail (failures.joinIntoString ("\n"));
+    }
+
+    //==============================================================================
+    struct Result
+    {
+        int64 numBlocks = 0;
+        double seconds = 0.0;
+        double p50 = 0.0, p99 = 0.0, p999 = 0.0, max = 0.0;    // block times in microseconds
+        int numBadBlocks = 0;
+        int64 numPublished = 0, numRestarts = 0;
+        NamedValueSet stepsPerSecond;                           // for each of the other threads
+
+        var toJson() const
+        {
+            auto* blockTimes = new DynamicObject();
+            blockTimes->setProperty ("p50", p50);
+            blockTimes->setProperty ("p99", p99);
+            blockTimes->setProperty ("p999", p999);
+            blockTimes->setProperty ("max", max);
+
+            auto* threads = new DynamicObject();
+
+            for (auto& step : stepsPerSecond)
+                threads->setProperty (step.name, step.value);
+
+            auto* root = new DynamicObject();
+            root->setProperty ("cpu", SystemStats::getCpuModel());
+            root->setProperty ("numCpus", SystemStats::getNumCpus());
+            root->setProperty ("blocks", numBlocks);
+            root->setProperty ("seconds", seconds);
+            root->setProperty ("blocksPerSecond", seconds > 0.0 ? (double) numBlocks / seconds : 0.0);
+            root->setProperty ("blockTimeMicroseconds", var (blockTimes));
+            root->setProperty ("threadStepsPerSecond", var (threads));
+            root->setProperty ("publishes", numPublished);
+            root->setProperty ("deviceRestarts", numRestarts);
+            root->setProperty ("badBlocks", numBadBlocks);
+            return var (root);
+        }
+    };
+
+private:
+    //==============================================================================
+    struct Fixture
+    {
+        const char* name;
+        int numChannels;
+        double sampleRate;
+        double seconds;
+    };
+
+    // a few shapes of buffer, one of them long enough to be streamed
+    static constexpr Fixture fixtureShapes[] = { { "mono-22k.wav",     1, 22050.0, 1.5 },
+                                                 { "stereo-44k.wav",   2, 44100.0, 3.0 },
+                                                 { "stereo-48k.wav",   2, 48000.0, 0.5 },
+                                                 { "surround-48k.wav", 6, 48000.0, 1.0 },
+                                                 { "long-stereo.wav",  2, 44100.0, 10.0 } };
+
+    /** Writes a 16-bit sine for each fixture, at a level that leaves plenty of headroom. */
+    static bool writeFixtures (const File& folder)
+    {
+        if (! folder.createDirectory())
+            return false;
+
+        WavAudioFormat wav;
+
+        for (auto& shape : fixtureShapes)
+        {
+            const auto numSamples = (int) (shape.seconds * shape.sampleRate);
+            AudioBuffer<float> samples (shape.numChannels, numSamples);
+
+            for (int channel = 0; channel < shape.numChannels; ++channel)
+            {
+                const auto step = MathConstants<double>::twoPi * 110.0 * (channel + 1) / shape.sampleRate;
+
+                for (int i = 0; i < numSamples; ++i)
+                    samples.setSample (channel, i, (float) (0.25 * std::sin (step * i)));
+            }
+
+            auto stream = std::make_unique<FileOutputStream> (folder.getChildFile (shape.name));
+
+            if (stream->failedToOpen())
+                return false;
+
+            std::unique_ptr<AudioFormatWriter> writer (wav.createWriterFor (stream.get(), shape.sampleRate,
+                                                                            (unsigned int) shape.numChannels, 16, {}, 0));
+
+            if (writer == nullptr)
+                return false;
+
+            stream.release();   // the writer owns it now
+
+            if (! writer->writeFromAudioSampleBuffer (samples, 0, numSamples))
+                return false;
+        }
+
+        return true;
+    }
+
+    //==============================================================================
+    /** A thread that calls its step function over and over, pausing for up to maxPauseMs in between. */
+    class Actor  : public Thread
+    {
+    public:
+        Actor (const String& name, int64 seed, int maxPause, std::function<void (Random&)> stepToRun)
+            : Thread (name), random (seed), maxPauseMs (maxPause), step (std::move (stepToRun))
+        {
+        }
+
+        ~Actor() override
+        {
+            stopThread (10000);
+        }
+
+        void run() override
+        {
+            while (! threadShouldExit())
+            {
+                step (random);
+                numSteps.fetch_add (1, std::memory_order_relaxed);
+
+                if (maxPauseMs > 0)
+                    wait (random.nextInt (maxPauseMs + 1));
+            }
+        }
+
+        int64 getNumSteps() const noexcept      { return numSteps.load (std::memory_order_relaxed); }
+
+    private:
+        Random random;
+        const int maxPauseMs;
+        std::function<void (Random&)> step;
+        std::atomic<int64> numSteps { 0 };
+    };
+
+    //==============================================================================
+    /** The app's engine, and what its buttons, timer and audio callback do with it. */
+    class Rig
+    {
+    public:
+        explicit Rig (const File& fixtureFolder)
+            : engine (getEngineOptions())
+        {
+            for (auto& shape : fixtureShapes)
+                fixtures.add (fixtureFolder.getChildFile (shape.name));
+
+            // small enough that adding to the cache keeps evicting
+            sampleCache->setMemoryBudget ((size_t) 16 * 1024 * 1024);
+        }
+
+        ~Rig()
+        {
+            engine.clear();
+            sampleCache->clearUnused();
+        }
+
+        /** Renders numBlocks on the calling thread with every other thread running, then stops them all. */
+        Result run (int64 numBlocks, int64 seed)
+        {
+            Random random (seed);
+            HeapBlock<float> blockTimes ((size_t) numBlocks);   // microseconds
+            AudioBuffer<float> output;
+            Result result;
+
+            OwnedArray<Actor> actors;
+            actors.add (new Actor ("loader",  seed + 1, 2,  [this] (Random& r) { queueLoad (r); }));
+            actors.add (new Actor ("clearer", seed + 2, 20, [this] (Random&)   { clear(); }));
+            actors.add (new Actor ("voices",  seed + 3, 1,  [this] (Random& r) { changeVoices (r); }));
+            actors.add (new Actor ("sweeper", seed + 4, 5,  [this] (Random& r) { sweep (r); }));
+
+            for (auto* actor : actors)
+                actor->startThread();
+
+            const auto start = Time::getHighResolutionTicks();
+            int blockSize = 0;
+
+            for (int64 block = 0; block < numBlocks; ++block)
+            {
+                if (block % blocksBetweenRestarts == 0)
+                {
+                    if (block > 0)
+                        engine.releaseResources();
+
+                    blockSize = restartDevice (random, output);
+                    ++result.numRestarts;
+                }
+
+                const auto blockStart = Time::getHighResolutionTicks();
+                engine.renderNextBlock ({ &output, 0, blockSize });
+                blockTimes[block] = (float) (Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - blockStart) * 1.0e6);
+
+                if (! isSane (output, blockSize))
+                    ++result.numBadBlocks;
+            }
+
+            result.seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+            result.numBlocks = numBlocks;
+
+            for (auto* actor : actors)
+                actor->signalThreadShouldExit();
+
+            for (auto* actor : actors)
+            {
+                actor->stopThread (10000);
+                result.stepsPerSecond.set (actor->getThreadName(), (double) actor->getNumSteps() / result.seconds);
+            }
+
+            engine.releaseResources();
+            result.numPublished = engine.getNumPublished();
+
+            std::sort (blockTimes.get(), blockTimes.get() + numBlocks);
+            auto percentile = [&] (double proportion) { return (double) blockTimes[jmin (numBlocks - 1, (int64) (proportion * (double) numBlocks))]; };
+
+            result.p50 = percentile (0.5);
+            result.p99 = percentile (0.99);
+            result.p999 = percentile (0.999);
+            result.max = blockTimes[numBlocks - 1];
+            return result;
+        }
+
+    private:
+        static LooperEngine::Options getEngineOptions()
+        {
+            // the fixtures are short, so the long one is streamed at a lower threshold than the app's
+            LooperEngine::Options options;
+            options.maxVoices = maxVoices;
+            options.streamingThresholdSeconds = 8.0f;
+            options.streamingWindowSamples = 1 << 15;
+            return options;
+        }
+
+        //==============================================================================
+        /** What AudioSourcePlayer does when the device is restarted, at a random new setting. Returns the block size. */
+        int restartDevice (Random& random, AudioBuffer<float>& output)
+        {
+            const int blockSizes[] = { 32, 64, 128, 256, 441, 512 };
+            const double sampleRates[] = { 44100.0, 48000.0 };
+            const int channelCounts[] = { 1, 2, 2, 6 };
+
+            const auto blockSize = blockSizes[random.nextInt (numElementsInArray (blockSizes))];
+            const auto sampleRate = sampleRates[random.nextInt (numElementsInArray (sampleRates))];
+            const auto numOutputChannels = channelCounts[random.nextInt (numElementsInArray (channelCounts))];
+
+            engine.getVoices().setNumWorkerThreads (random.nextInt (3));
+            output.setSize (numOutputChannels, blockSize);
+            engine.prepareToPlay (blockSize, sampleRate, numOutputChannels);
+            return blockSize;
+        }
+
+        /** False if the block has anything in it that no mix of the fixtures could produce. */
+        static bool isSane (const AudioBuffer<float>& output, int numSamples) noexcept
+        {
+            // every fixture is at -12 dB, so even every voice at once stays well inside this
+            const auto limit = 0.25f * 0.25f * (float) maxVoices + 1.0f;
+
+            for (int channel = 0; channel < output.getNumChannels(); ++channel)
+            {
+                const auto* samples = output.getReadPointer (channel);
+
+                // written this way round so that a NaN fails it too
+                for (int i = 0; i < numSamples; ++i)
+                    if (! (std::abs (samples[i]) <= limit))
+                        return false;
+            }
+
+            return true;
+        }
+
+        //==============================================================================
+        /** The file chooser's callback: one file to play now, or a batch of preloads. */
+        void queueLoad (Random& random)
+        {
+            LooperEngine::LoadSettings settings;
+            settings.mapWavFiles = random.nextInt (4) == 0;
+            settings.convertSampleRate = random.nextBool();
+            settings.storageFormat = (SampleFormat) random.nextInt (3);
+
+            const auto file = fixtures[random.nextInt (fixtures.size())];
+
+            if (random.nextInt (4) == 0)
+            {
+                // preloads aren't superseded, so on a slow machine they'd pile up without limit
+                if (engine.getNumPendingLoads() >= maxPendingPreloads)
+                    return;
+
+                engine.preloadFile (file, settings);
+            }
+            else
+            {
+                engine.playFile (file, settings);
+            }
+        }
+
+        //==============================================================================
+        /** clearButtonClicked(). */
+        void clear()
+        {
+            engine.clear();
+        }
+
+        void changeVoices (Random& random)
+        {
+            auto& voices = engine.getVoices();
+
+            switch (random.nextInt (4))
+            {
+                case 0:
+                case 1:
+                    if (auto buffer = engine.getCurrentBuffer())
+                        voices.startVoice (buffer, 0.25f, {}, random.nextInt (buffer->getNumSamples()));
+                    break;
+
+                case 2:
+                    voices.setVoiceSpeed (random.nextInt (maxVoices), 0.5f + random.nextFloat() * 1.5f);
+                    break;
+
+                default:
+                    voices.stopVoice (random.nextInt (maxVoices));
+                    break;
+            }
+        }
+
+        /** Reads everything timerCallback() shows, and sometimes drops the buffers nothing is using. */
+        void sweep (Random& random)
+        {
+            trace->nameCurrentThread ("Sweeper");
+            const TraceRecorder::Span span { *trace, "timerCallback" };
+
+            auto& voices = engine.getVoices();
+            voices.releaseFinishedVoices();
+
+            String status;
+
+            if (auto stream = engine.getCurrentStream())
+                status << stream->getName() << (int64) stream->getWindowSizeInBytes() << stream->getNumUnderruns();
+            else if (auto numVoices = voices.getNumActiveVoices())
+                status << numVoices << voices.getCpuLoad();
+            else if (auto buffer = engine.getCurrentBuffer())
+                status << buffer->getName() << (int64) buffer->getSizeInBytes() << (int) buffer->getSampleFormat();
+
+            status << sampleCache->getStatistics().numBuffers
+                   << (int64) sampleMemory->getStatistics().bytesInUse
+                   << engine.getCallbackStats().toString();
+
+            if (random.nextInt (8) == 0)
+                sampleCache->clearUnused();
+        }
+
+        //==============================================================================
+        static constexpr int maxVoices = 32;
+        static constexpr int maxPendingPreloads = 8;
+        static constexpr int64 blocksBetweenRestarts = 5000;
+
+        Array<File> fixtures;
+
+        SharedResourcePointer<SampleMemoryPool> sampleMemory;
+        SharedResourcePointer<SampleCache> sampleCache;
+        SharedResourcePointer<TraceRecorder> trace;
+
+        LooperEngine engine;
+
+        JUCE_DECLARE_NON_COPYABLE (Rig)
+    };
+
+    //==============================================================================
+    /** Lists what got worse than the baseline by more than the tolerance. */
+    static StringArray compareWithBaseline (const var& current, const var& baseline, double tolerance)
+    {
+        StringArray regressions;
+
+        for (auto name : { "p99", "p999" })
+        {
+            const auto now = (double) current["blockTimeMicroseconds"][name];
+            const auto before = (double) baseline["blockTimeMicroseconds"][name];
+
+            if (before > 0.0 && now > before * (1.0 + tolerance))
+                regressions.add (String (name) + " block time went from " + String (before, 1) + " to " + String (now, 1) + " us");
+        }
+
+        const auto now = (double) current["blocksPerSecond"];
+        const auto before = (double) baseline["blocksPerSecond"];
+
+        if (before > 0.0 && now < before * (1.0 - tolerance))
+            regressions.add ("the audio thread's throughput went from " + String (roundToInt (before))
+                               + " to " + String (roundToInt (now)) + " blocks per second");
+
+        return regressions;
+    }
+
+    static double getOption (const ArgumentList& args, StringRef option, double defaultValue)
+    {
+        const auto value = args.getValueForOption (option);
+        return value.isEmpty() ? defaultValue : value.getDoubleValue();
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (StressTest)
+};
@@ -0,0 +1,301 @@
+/*
+  ==============================================================================
+
+    TraceRecorder.h
+    Created: 16 Oct 2026 11:41:45pm
+    Author:  HFM
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/** Records timed spans and instant events from any thread, the audio thread included, and
+    exports them as a Chrome trace (chrome://tracing, or ui.perfetto.dev).
+
+    Each thread writes to a ring of its own, claimed the first time it records anything, so
+    recording never locks, allocates or waits on another thread: it's two clock reads for a
+    span and a few relaxed stores. The rings are allocated up front, for up to maxThreads
+    threads with the last eventsPerThread events each (about 4 MB in all). Threads beyond
+    that are counted in getNumDropped() rather than recorded. Event names must be string
+    literals, since only the pointer is kept.
+
+    Exporting copies each ring while its thread keeps writing, and throws away anything the
+    thread overwrote during the copy, so it can be done at any time without stopping the
+    audio. Use it through a SharedResourcePointer<TraceRecorder>, so that every part of the
+    app records into the same trace.
+*/
+class TraceRecorder
+{
+public:
+    static constexpr int maxThreads = 32;
+    static constexpr int eventsPerThread = 4096;    // a power of two
+
+    /** Records the time from its construction to its destruction as one span. */
+    class Span
+    {
+    public:
+        Span (TraceRecorder& recorderToUse, const char* spanName, int64 spanValue = 0) noexcept
+            : recorder (recorderToUse), name (spanName), value (spanValue),
+              startTicks (recorder.isEnabled() ? Time::getHighResolutionTicks() : 0)
+        {
+        }
+
+        ~Span() noexcept
+        {
+            if (startTicks != 0)
+                recorder.record (name, startTicks, Time::getHighResolutionTicks() - startTicks, value);
+        }
+
+        /** Changes the number shown with the span, e.g. once it's known how much was done. */
+        void setValue (int64 newValue) noexcept     { value = newValue; }
+
+    private:
+        TraceRecorder& recorder;
+        const char* const name;
+        int64 value;
+        const int64 startTicks;
+
+        JUCE_DECLARE_NON_COPYABLE (Span)
+    };
+
+    //==============================================================================
+    TraceRecorder()
+        : id (++lastRecorderId),
+          originTicks (Time::getHighResolutionTicks())
+    {
+        for (auto& ring : rings)
+            ring.events = std::make_unique<Event[]> ((size_t) eventsPerThread);
+    }
+
+    /** Records a single point in time, e.g. a buffer being published. */
+    void instant (const char* name, int64 value = 0) noexcept
+    {
+        if (isEnabled())
+            record (name, Time::getHighResolutionTicks(), -1, value);
+    }
+
+    /** Names the calling thread in the trace. Cheap enough to call at the start of every callback. */
+    void nameCurrentThread (const char* name) noexcept
+    {
+        if (auto* ring = getRingForCurrentThread())
+            ring->threadName.store (name, std::memory_order_relaxed);
+    }
+
+    /** Turns recording on or off; it starts on. Exporting still works while it's off. */
+    void setEnabled (bool shouldBeEnabled) noexcept     { enabled.store (shouldBeEnabled, std::memory_order_relaxed); }
+    bool isEnabled() const noexcept                     { return enabled.load (std::memory_order_relaxed); }
+
+    /** The number of events that weren't recorded because every ring was taken. */
+    int64 getNumDropped() const noexcept                { return numDropped.load (std::memory_order_relaxed); }
+
+    /** An identifier to record with an object's events, so that e.g. a buffer's publish,
+        retire and destroy can be matched up in the trace.
+    */
+    static int64 getId (const void* object) noexcept    { return (int64) reinterpret_cast<pointer_sized_int> (object); }
+
+    //==============================================================================
+    /** Returns the trace in the Chrome trace event format: everything still in the rings, or
+        only what happened in the last so many seconds. Safe to call from any thread.
+    */
+    String createChromeJson (double lastSeconds = 0.0) const
+    {
+        const auto nowTicks = Time::getHighResolutionTicks();
+        const auto cutoffTicks = lastSeconds > 0.0 ? nowTicks - Time::secondsToHighResolutionTicks (lastSeconds) : 0;
+        const auto ticksToMicroseconds = 1.0e6 / (double) Time::getHighResolutionTicksPerSecond();
+
+        Array<var> traceEvents;
+        std::vector<EventCopy> copied;
+
+        for (int threadIndex = 0; threadIndex < maxThreads; ++threadIndex)
+        {
+            const auto& ring = rings[(size_t) threadIndex];
+            const auto threadId = ring.threadId.load();
+
+            if (threadId == nullptr)
+                continue;
+
+            copyEvents (ring, copied);
+
+            auto* threadArgs = new DynamicObject();
+            const auto* threadName = ring.threadName.load (std::memory_order_relaxed);
+            threadArgs->setProperty ("name", threadName != nullptr ? String (threadName)
+                                                                   : "Thread " + String::toHexString (getId (threadId)));
+
+            auto* metadata = new DynamicObject();
+            metadata->setProperty ("name", "thread_name");
+            metadata->setProperty ("ph", "M");
+            metadata->setProperty ("pid", 1);
+            metadata->setProperty ("tid", threadIndex + 1);
+            metadata->setProperty ("args", var (threadArgs));
+            traceEvents.add (var (metadata));
+
+            for (auto& event : copied)
+            {
+                if (event.startTicks < cutoffTicks)
+                    continue;
+
+                auto* object = new DynamicObject();
+                object->setProperty ("name", String (event.name));
+                object->setProperty ("pid", 1);
+                object->setProperty ("tid", threadIndex + 1);
+                object->setProperty ("ts", (double) (event.startTicks - originTicks) * ticksToMicroseconds);
+
+                if (event.durationTicks >= 0)
+                {
+                    object->setProperty ("ph", "X");
+                    object->setProperty ("dur", (double) event.durationTicks * ticksToMicroseconds);
+                }
+                else
+                {
+                    object->setProperty ("ph", "i");
+                    object->setProperty ("s", "t");
+                }
+
+                if (event.value != 0)
+                {
+                    auto* args = new DynamicObject();
+                    args->setProperty ("value", event.value);
+                    object->setProperty ("args", var (args));
+                }
+
+                traceEvents.add (var (object));
+            }
+        }
+
+        auto* root = new DynamicObject();
+        root->setProperty ("traceEvents", traceEvents);
+        root->setProperty ("displayTimeUnit", "ms");
+        return JSON::toString (var (root), true);
+    }
+
+    bool writeChromeJson (const File& file, double lastSeconds = 0.0) const
+    {
+        return file.replaceWithText (createChromeJson (lastSeconds));
+    }
+
+private:
+    //==============================================================================
+    // every field is atomic so that an export can read a ring while its thread writes to it
+    struct Event
+    {
+        std::atomic<const char*> name { nullptr };
+        std::atomic<int64> startTicks { 0 }, durationTicks { 0 }, value { 0 };
+    };
+
+    struct EventCopy
+    {
+        const char* name;
+        int64 startTicks, durationTicks, value;
+    };
+
+    /** One thread's events. Only that thread writes to it, so a write is a handful of relaxed stores. */
+    struct Ring
+    {
+        std::atomic<Thread::ThreadID> threadId { nullptr };
+        std::atomic<const char*> threadName { nullptr };
+        std::atomic<uint64> numStarted { 0 }, numWritten { 0 };
+        std::unique_ptr<Event[]> events;
+    };
+
+    void record (const char* name, int64 startTicks, int64 durationTicks, int64 value) noexcept
+    {
+        auto* ring = getRingForCurrentThread();
+
+        if (ring == nullptr)
+        {
+            numDropped.fetch_add (1, std::memory_order_relaxed);
+            return;
+        }
+
+        // a seqlock without the lock: numStarted marks the slot as being overwritten
+        // before any of it changes, and numWritten publishes it once it's complete
+        const auto index = ring->numWritten.load (std::memory_order_relaxed);
+        ring->numStarted.store (index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_release);
+
+        auto& event = ring->events[(size_t) (index & (eventsPerThread - 1))];
+        event.name.store (name, std::memory_order_relaxed);
+        event.startTicks.store (startTicks, std::memory_order_relaxed);
+        event.durationTicks.store (durationTicks, std::memory_order_relaxed);
+        event.value.store (value, std::memory_order_relaxed);
+
+        ring->numWritten.store (index + 1, std::memory_order_release);
+    }
+
+    /** Copies out the events in a ring that its thread didn't overwrite while they were being copied. */
+    static void copyEvents (const Ring& ring, std::vector<EventCopy>& result)
+    {
+        result.clear();
+
+        const auto numWritten = ring.numWritten.load (std::memory_order_acquire);
+        const auto first = numWritten > (uint64) eventsPerThread ? numWritten - (uint64) eventsPerThread : 0;
+
+        for (auto index = first; index < numWritten; ++index)
+        {
+            const auto& event = ring.events[(size_t) (index & (eventsPerThread - 1))];
+            result.push_back ({ event.name.load (std::memory_order_relaxed),
+                                event.startTicks.load (std::memory_order_relaxed),
+                                event.durationTicks.load (std::memory_order_relaxed),
+                                event.value.load (std::memory_order_relaxed) });
+        }
+
+        std::atomic_thread_fence (std::memory_order_acquire);
+
+        // anything older than this may have been overwritten part way through the copy
+        const auto numStarted = ring.numStarted.load (std::memory_order_relaxed);
+        const auto firstIntact = numStarted > (uint64) eventsPerThread ? numStarted - (uint64) eventsPerThread : 0;
+
+        if (firstIntact > first)
+            result.erase (result.begin(), result.begin() + (std::ptrdiff_t) jmin ((uint64) result.size(), firstIntact - first));
+    }
+
+    /** Finds or claims the calling thread's ring, or returns nullptr if they're all taken. */
+    Ring* getRingForCurrentThread() noexcept
+    {
+        // the last recorder each thread used, by id rather than address, which could be reused
+        struct Cache
+        {
+            uint32 recorderId;
+            Ring* ring;
+        };
+
+        static thread_local Cache cache { 0, nullptr };
+
+        if (cache.recorderId == id)
+            return cache.ring;
+
+        const auto threadId = Thread::getCurrentThreadId();
+        Ring* found = nullptr;
+
+        for (auto& ring : rings)
+            if (ring.threadId.load() == threadId)
+                found = &ring;
+
+        for (auto& ring : rings)
+        {
+            if (found != nullptr)
+                break;
+
+            Thread::ThreadID expected = nullptr;
+
+            if (ring.threadId.compare_exchange_strong (expected, threadId))
+                found = &ring;
+        }
+
+        cache = { id, found };
+        return found;
+    }
+
+    inline static std::atomic<uint32> lastRecorderId { 0 };
+
+    const uint32 id;
+    const int64 originTicks;
+    std::atomic<bool> enabled { true };
+    std::atomic<int64> numDropped { 0 };
+    std::array<Ring, (size_t) maxThreads> rings;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TraceRecorder)
+};